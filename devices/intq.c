@@ -3,14 +3,15 @@
 #include "threads/thread.h"
 
 static int next (int pos);
-static void wait (struct intq *q, struct thread **waiter);
-static void signal (struct intq *q, struct thread **waiter);
+static void wait (struct intq *q, struct waitqueue *waiters);
+static void signal (struct intq *q, struct waitqueue *waiters);
 
 /* Initializes interrupt queue Q. */
 void
 intq_init (struct intq *q) {
-	lock_init (&q->lock);
-	q->not_full = q->not_empty = NULL;
+	spinlock_init (&q->buf_lock);
+	waitqueue_init (&q->not_full);
+	waitqueue_init (&q->not_empty);
 	q->head = q->tail = 0;
 }
 
@@ -37,16 +38,16 @@ intq_getc (struct intq *q) {
 	uint8_t byte;
 
 	ASSERT (intr_get_level () == INTR_OFF);
+	spinlock_acquire (&q->buf_lock);
 	while (intq_empty (q)) {
 		ASSERT (!intr_context ());
-		lock_acquire (&q->lock);
 		wait (q, &q->not_empty);
-		lock_release (&q->lock);
 	}
 
 	byte = q->buf[q->tail];
 	q->tail = next (q->tail);
 	signal (q, &q->not_full);
+	spinlock_release (&q->buf_lock);
 	return byte;
 }
 
@@ -57,16 +58,16 @@ intq_getc (struct intq *q) {
 void
 intq_putc (struct intq *q, uint8_t byte) {
 	ASSERT (intr_get_level () == INTR_OFF);
+	spinlock_acquire (&q->buf_lock);
 	while (intq_full (q)) {
 		ASSERT (!intr_context ());
-		lock_acquire (&q->lock);
 		wait (q, &q->not_full);
-		lock_release (&q->lock);
 	}
 
 	q->buf[q->head] = byte;
 	q->head = next (q->head);
 	signal (q, &q->not_empty);
+	spinlock_release (&q->buf_lock);
 }
 
 /* Returns the position after POS within an intq. */
@@ -75,31 +76,31 @@ next (int pos) {
 	return (pos + 1) % INTQ_BUFSIZE;
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+/* WAITERS must be the address of Q's not_empty or not_full
+   member.  Waits until the given condition may be true; the
+   caller must check again.  Q's buf_lock must be held; it is
+   released while waiting. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) {
+wait (struct intq *q UNUSED, struct waitqueue *waiters) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT ((waiter == &q->not_empty && intq_empty (q))
-			|| (waiter == &q->not_full && intq_full (q)));
+	ASSERT (spinlock_held (&q->buf_lock));
+	ASSERT ((waiters == &q->not_empty && intq_empty (q))
+			|| (waiters == &q->not_full && intq_full (q)));
 
-	*waiter = thread_current ();
-	thread_block ();
+	waitqueue_wait (waiters, &q->buf_lock, true, INT64_MAX);
 }
 
-/* WAITER must be the address of Q's not_empty or not_full
-   member, and the associated condition must be true.  If a
-   thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+/* WAITERS must be the address of Q's not_empty or not_full
+   member, and the associated condition must be true.  If any
+   thread is waiting for the condition, wakes up the one with the
+   highest priority.  Does not preempt the running thread, since
+   this may be called from an interrupt handler. */
 static void
-signal (struct intq *q UNUSED, struct thread **waiter) {
+signal (struct intq *q UNUSED, struct waitqueue *waiters) {
 	ASSERT (intr_get_level () == INTR_OFF);
-	ASSERT ((waiter == &q->not_empty && !intq_empty (q))
-			|| (waiter == &q->not_full && !intq_full (q)));
+	ASSERT ((waiters == &q->not_empty && !intq_empty (q))
+			|| (waiters == &q->not_full && !intq_full (q)));
 
-	if (*waiter != NULL) {
-		thread_unblock (*waiter);
-		*waiter = NULL;
-	}
+	waitqueue_wake_one (waiters);
 }
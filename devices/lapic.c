@@ -0,0 +1,157 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC.
+
+   Every CPU has a local APIC, which delivers interrupts to it
+   and lets it send interprocessor interrupts (IPIs) to the other
+   CPUs.  Its registers are memory-mapped at the same physical
+   address on every CPU, but each CPU sees only its own.  The
+   8259A PIC keeps delivering device interrupts to the BSP, in
+   "virtual wire" mode through the BSP's LINT0 pin.
+
+   See [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)". */
+
+/* APIC base address MSR. */
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_BSP (1 << 8)          /* Set on the BSP. */
+#define APIC_BASE_ADDR 0xffffff000ULL   /* Physical base address. */
+
+/* Register offsets. */
+#define LAPIC_ID 0x020                  /* Local APIC ID. */
+#define LAPIC_TPR 0x080                 /* Task priority. */
+#define LAPIC_EOI 0x0b0                 /* End of interrupt. */
+#define LAPIC_SVR 0x0f0                 /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO 0x300              /* Interrupt command, low half. */
+#define LAPIC_ICR_HI 0x310              /* Interrupt command, high half. */
+#define LAPIC_LINT0 0x350               /* Local interrupt 0. */
+#define LAPIC_LINT1 0x360               /* Local interrupt 1. */
+
+#define SVR_ENABLE 0x100                /* Software enable. */
+
+/* Local vector table entries. */
+#define LVT_NMI 0x400                   /* Deliver as NMI. */
+#define LVT_EXTINT 0x700                /* Deliver from the PIC. */
+#define LVT_MASKED 0x10000              /* Masked. */
+
+/* Interrupt command register. */
+#define ICR_FIXED 0x000                 /* Deliver vector. */
+#define ICR_INIT 0x500                  /* INIT. */
+#define ICR_STARTUP 0x600               /* Startup IPI. */
+#define ICR_PENDING 0x1000              /* Delivery in progress. */
+#define ICR_ASSERT 0x4000               /* Assert (not de-assert). */
+#define ICR_ALL_BUT_SELF 0xc0000        /* Every CPU but the sender. */
+
+/* Kernel virtual address of the local APIC's registers. */
+static volatile uint8_t *lapic;
+
+static uint32_t
+lapic_read (int reg) {
+	return *(volatile uint32_t *) (lapic + reg);
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	*(volatile uint32_t *) (lapic + reg) = value;
+}
+
+/* Maps the local APIC's registers, at physical address PA, into
+   the kernel's address space as uncached memory.  They are above
+   the end of RAM, so paging_init() did not map them. */
+static void
+lapic_map (uint64_t pa) {
+	void *va = ptov (pa);
+	uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) va, 1);
+
+	if (pte == NULL)
+		PANIC ("lapic: cannot map registers");
+	*pte = pa | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) va);
+	lapic = va;
+}
+
+/* Enables the running CPU's local APIC.  Called once by every
+   CPU, with interrupts off; the BSP must be first. */
+void
+lapic_init (void) {
+	uint64_t base = read_msr (MSR_APIC_BASE);
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (lapic == NULL) {
+		ASSERT (base & APIC_BASE_BSP);
+		lapic_map (base & APIC_BASE_ADDR);
+	}
+
+	lapic_write (LAPIC_TPR, 0);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+
+	/* Only the BSP takes interrupts from the PIC. */
+	lapic_write (LAPIC_LINT0, base & APIC_BASE_BSP ? LVT_EXTINT : LVT_MASKED);
+	lapic_write (LAPIC_LINT1, LVT_NMI);
+}
+
+/* Returns the running CPU's local APIC ID. */
+uint8_t
+lapic_id (void) {
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being handled on the running CPU. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends the interprocessor interrupt described by COMMAND to the
+   CPU whose local APIC ID is DEST, and waits until the local APIC
+   has accepted it. */
+static void
+send (uint8_t dest, uint32_t command) {
+	enum intr_level old_level = intr_disable ();
+
+	lapic_write (LAPIC_ICR_HI, (uint32_t) dest << 24);
+	lapic_write (LAPIC_ICR_LO, command);
+	while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+		asm volatile ("pause");
+	intr_set_level (old_level);
+}
+
+/* Interrupts the CPU whose local APIC ID is APIC_ID with vector
+   VEC. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec) {
+	send (apic_id, ICR_FIXED | ICR_ASSERT | vec);
+}
+
+/* Interrupts every CPU except the running one with vector VEC. */
+void
+lapic_broadcast_ipi (uint8_t vec) {
+	send (0, ICR_ALL_BUT_SELF | ICR_FIXED | ICR_ASSERT | vec);
+}
+
+/* Starts every application processor executing in real mode at
+   physical address PAGE * 4 kB, with the INIT-SIPI-SIPI sequence
+   from [MP] B.4 "Application Processor Startup".  Must be called
+   from a kernel thread with interrupts on, after the timer has
+   been calibrated. */
+void
+lapic_start_aps (uint8_t page) {
+	int i;
+
+	send (0, ICR_ALL_BUT_SELF | ICR_INIT | ICR_ASSERT);
+	timer_msleep (10);
+	for (i = 0; i < 2; i++) {
+		send (0, ICR_ALL_BUT_SELF | ICR_STARTUP | ICR_ASSERT | page);
+		timer_usleep (200);
+	}
+}
@@ -5,8 +5,10 @@
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,19 +19,56 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the number of PIT counts in one timer tick. */
+#define PIT_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Largest count the 8254 counter can be loaded with. */
+#define PIT_COUNT_MAX 0xffff
+
+/* Don't start or cancel a one-shot this close to its expiry, in
+   PIT counts, so that the interrupt cannot slip in between
+   reading the counter and reprogramming it. */
+#define PIT_MARGIN (PIT_COUNT / 16)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* If false (default), the timer interrupts TIMER_FREQ times per
+   second.  If true, the idle thread programs the PIT one-shot to
+   the next sleeper's wakeup instead of taking every tick.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless state.  While a one-shot is pending, the PIT is in
+   mode 0 and oneshot_ticks is the number of ticks that will have
+   passed when it fires, ONESHOT_COUNT PIT counts after it was
+   loaded; the first tick boundary is oneshot_first counts in.
+   oneshot_ticks is 0 while the PIT is periodic. */
+static int64_t oneshot_ticks;
+static unsigned oneshot_first;
+static unsigned oneshot_count;
+
+/* Number of timer interrupts taken. */
+static int64_t timer_interrupts;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of TSC cycles per second, measured over
+   TSC_CALIBRATE_TICKS timer ticks by timer_calibrate(). */
+#define TSC_CALIBRATE_TICKS 4
+static uint64_t tsc_hz;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
-
-static struct list sleep_list; // Alarm clock 개선
+static void pit_periodic (void);
+static void pit_oneshot (unsigned count);
+static bool pit_read (unsigned *count);
+static void timer_advance (int64_t n);
 
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
@@ -37,21 +76,88 @@ static struct list sleep_list; // Alarm clock 개선
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	pit_periodic ();
+	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+}
 
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic tick by
+   a single interrupt at the tick on which the earliest sleeping
+   thread is due, or as far ahead as the 16-bit counter reaches,
+   whichever comes first.
+
+   The PIT interrupts only the BSP, which forwards each tick to
+   the other CPUs, so this only happens on the BSP and only when
+   every CPU is idle.  Work can reach an idle CPU only through an
+   interrupt from the BSP, and any interrupt makes the BSP leave
+   its idle loop through timer_idle_exit() first. */
+void
+timer_idle_enter (void) {
+	int64_t n;
+	unsigned first;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot_ticks != 0 || this_cpu ()->id != 0)
+		return;
+	if (!thread_cpus_idle ())
+		return;
+
+	/* Number of tick boundaries until the next wakeup.  If it is
+	   the very next one, the periodic tick will do. */
+	n = thread_next_wakeup () - ticks;
+	if (n <= 1)
+		return;
+
+	/* The first boundary is what is left of the current period. */
+	if (!pit_read (&first) || first < PIT_MARGIN)
+		return;
+	if (n > 1 + (PIT_COUNT_MAX - first) / PIT_COUNT)
+		n = 1 + (PIT_COUNT_MAX - first) / PIT_COUNT;
+
+	oneshot_ticks = n;
+	oneshot_first = first;
+	oneshot_count = first + (n - 1) * PIT_COUNT;
+	pit_oneshot (oneshot_count);
+}
 
-	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+/* Called by the idle thread, with interrupts off, after it has
+   been woken by an interrupt.  If that was not the one-shot timer
+   interrupt, then another thread may be about to run and needs
+   the tick back: catches up on the ticks that have already passed
+   and arranges for the periodic tick to restart at the next tick
+   boundary. */
+void
+timer_idle_exit (void) {
+	unsigned left, elapsed, passed, next;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (oneshot_ticks == 0 || this_cpu ()->id != 0)
+		return;
+
+	/* If the one-shot has expired or is about to, its interrupt
+	   will do all of this. */
+	if (!pit_read (&left) || left < PIT_MARGIN)
+		return;
+
+	elapsed = oneshot_count - left;
+	passed = elapsed < oneshot_first ? 0
+	         : 1 + (elapsed - oneshot_first) / PIT_COUNT;
+	next = oneshot_first + passed * PIT_COUNT;
+
+	oneshot_ticks = 1;
+	oneshot_first = oneshot_count = next - elapsed;
+	pit_oneshot (oneshot_count);
+	timer_advance (passed);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
 void
 timer_calibrate (void) {
 	unsigned high_bit, test_bit;
+	int64_t start;
+	uint64_t start_tsc;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
@@ -71,6 +177,32 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	/* Count TSC cycles from one tick boundary to another. */
+	start = ticks;
+	while (ticks == start)
+		barrier ();
+	start_tsc = rdtsc ();
+	start = ticks;
+	while (ticks < start + TSC_CALIBRATE_TICKS)
+		barrier ();
+	tsc_hz = (rdtsc () - start_tsc) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+}
+
+/* Returns the number of TSC cycles per second.  Only valid after
+   timer_calibrate(). */
+uint64_t
+timer_tsc_hz (void) {
+	return tsc_hz;
+}
+
+/* Converts CYCLES of the TSC to microseconds.  Returns 0 before
+   timer_calibrate(). */
+int64_t
+timer_cycles_to_us (uint64_t cycles) {
+	if (tsc_hz == 0)
+		return 0;
+	return cycles / tsc_hz * 1000000 + cycles % tsc_hz * 1000000 / tsc_hz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -133,6 +265,8 @@ timer_nsleep (int64_t ns) {
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	if (timer_tickless)
+		printf ("Timer: %"PRId64" interrupts (tickless)\n", timer_interrupts);
 }
 
 
@@ -142,9 +276,64 @@ timer_print_stats (void) {
 */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	thread_tick ();
-    thread_check_sleep_list(); // 커널이 이 인터럽트 호출 시 리스트를 확인 & 깨우기
+	int64_t n = 1;
+
+	timer_interrupts++;
+	if (oneshot_ticks != 0) {
+		/* A one-shot has expired: go back to periodic ticks,
+		   starting from this tick boundary. */
+		n = oneshot_ticks;
+		oneshot_ticks = 0;
+		pit_periodic ();
+	}
+	timer_advance (n);
+	smp_broadcast_tick ();
+}
+
+/* Advances the timer by N ticks, doing the per-tick work for each
+   of them. */
+static void
+timer_advance (int64_t n) {
+	while (n-- > 0) {
+		ticks++;
+		thread_tick ();
+		thread_check_sleep_list(); // 커널이 이 인터럽트 호출 시 sleep queue를 확인 & 깨우기
+	}
+}
+
+/* Sets up the 8254 Programmable Interval Timer (PIT) to
+   interrupt TIMER_FREQ times per second. */
+static void
+pit_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_COUNT & 0xff);
+	outb (0x40, PIT_COUNT >> 8);
+}
+
+/* Sets up the PIT to interrupt once, COUNT PIT counts from now. */
+static void
+pit_oneshot (unsigned count) {
+	ASSERT (count > 0 && count <= PIT_COUNT_MAX);
+
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Stores the current value of PIT counter 0 in *COUNT.  Returns
+   false if the counter is in mode 0 and has already reached its
+   terminal count, true otherwise. */
+static bool
+pit_read (unsigned *count) {
+	uint8_t status;
+
+	outb (0x43, 0xc2);    /* Read-back: status and count of counter 0. */
+	status = inb (0x40);
+	*count = inb (0x40);
+	*count |= inb (0x40) << 8;
+
+	/* In mode 0 the OUT pin (bit 7) goes high at terminal count. */
+	return (status & 0x0e) != 0 || (status & 0x80) == 0;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -19,6 +20,17 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Protects the entries of directories.  Lookups and listings
+ * take it shared, additions and removals exclusive.  There is
+ * only the root directory, so one lock covers them all. */
+static struct rwlock dir_lock;
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	rwlock_init (&dir_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -109,10 +121,12 @@ dir_lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	rwlock_acquire_shared (&dir_lock);
 	if (lookup (dir, name, &e, NULL))
 		*inode = inode_open (e.inode_sector);
 	else
 		*inode = NULL;
+	rwlock_release_shared (&dir_lock);
 
 	return *inode != NULL;
 }
@@ -137,6 +151,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 		return false;
 
 	/* Check that NAME is not in use. */
+	rwlock_acquire_exclusive (&dir_lock);
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
@@ -159,6 +174,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+	rwlock_release_exclusive (&dir_lock);
 	return success;
 }
 
@@ -176,6 +192,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
+	rwlock_acquire_exclusive (&dir_lock);
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
 
@@ -194,6 +211,7 @@ dir_remove (struct dir *dir, const char *name) {
 	success = true;
 
 done:
+	rwlock_release_exclusive (&dir_lock);
 	inode_close (inode);
 	return success;
 }
@@ -204,13 +222,17 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool found = false;
 
+	rwlock_acquire_shared (&dir_lock);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	rwlock_release_shared (&dir_lock);
+	return found;
 }
@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -30,9 +32,13 @@ bytes_to_sectors (off_t size) {
 struct inode {
 	struct list_elem elem;              /* Element in inode list. */
 	disk_sector_t sector;               /* Sector number of disk location. */
-	int open_cnt;                       /* Number of openers. */
+	int open_cnt;                       /* Number of openers, changed
+	                                       atomically. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rwlock;               /* Held shared to read data,
+	                                       exclusive to write it or
+	                                       change deny_write_cnt. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -53,10 +59,37 @@ byte_to_sector (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Opening an inode that is already open
+ * only needs it shared. */
+static struct rwlock open_inodes_lock;
+
+/* Cache that in-memory inodes are allocated from. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+	inode_cache = kmem_cache_create ("struct inode", sizeof (struct inode),
+	                                 0, NULL);
+	if (inode_cache == NULL)
+		PANIC ("inode_init: out of memory");
+}
+
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+ * if SECTOR is not open.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode_reopen (inode);
+	}
+	return NULL;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,31 +134,38 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
-	struct inode *inode;
+	struct inode *inode, *other;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_acquire_shared (&open_inodes_lock);
+	inode = find_open_inode (sector);
+	rwlock_release_shared (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (inode_cache);
 	if (inode == NULL)
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	rwlock_init (&inode->rwlock);
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Another thread may have opened it while we read it. */
+	rwlock_acquire_exclusive (&open_inodes_lock);
+	other = find_open_inode (sector);
+	if (other == NULL)
+		list_push_front (&open_inodes, &inode->elem);
+	rwlock_release_exclusive (&open_inodes_lock);
+	if (other != NULL) {
+		kmem_cache_free (inode_cache, inode);
+		return other;
+	}
 	return inode;
 }
 
@@ -133,7 +173,7 @@ inode_open (disk_sector_t sector) {
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_fetch_add (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -148,14 +188,23 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
+	/* The count only drops with open_inodes_lock held exclusive,
+	 * so that find_open_inode() cannot revive an inode on its way
+	 * out. */
+	rwlock_acquire_exclusive (&open_inodes_lock);
+	last = __atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED) == 0;
+	if (last)
 		list_remove (&inode->elem);
+	rwlock_release_exclusive (&open_inodes_lock);
+
+	/* Release resources if this was the last opener. */
+	if (last) {
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,7 +213,7 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
+		kmem_cache_free (inode_cache, inode);
 	}
 }
 
@@ -185,6 +234,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
 
+	rwlock_acquire_shared (&inode->rwlock);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -220,6 +270,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
+	rwlock_release_shared (&inode->rwlock);
 	free (bounce);
 
 	return bytes_read;
@@ -237,8 +288,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
 
-	if (inode->deny_write_cnt)
+	rwlock_acquire_exclusive (&inode->rwlock);
+	if (inode->deny_write_cnt) {
+		rwlock_release_exclusive (&inode->rwlock);
 		return 0;
+	}
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -282,6 +336,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
+	rwlock_release_exclusive (&inode->rwlock);
 	free (bounce);
 
 	return bytes_written;
@@ -292,8 +347,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_exclusive (&inode->rwlock);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_exclusive (&inode->rwlock);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +358,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_exclusive (&inode->rwlock);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_exclusive (&inode->rwlock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
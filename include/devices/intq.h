@@ -15,7 +15,9 @@
    and condition variables from threads/synch.h cannot be used in
    this case, as they normally would, because they can only
    protect kernel threads from one another, not from interrupt
-   handlers. */
+   handlers.  A spinlock guards the queue against other CPUs, and
+   threads sleep on wait queues, which any number of them may
+   share. */
 
 /* Queue buffer size, in bytes. */
 #define INTQ_BUFSIZE 64
@@ -23,9 +25,9 @@
 /* A circular queue of bytes. */
 struct intq {
 	/* Waiting threads. */
-	struct lock lock;           /* Only one thread may wait at once. */
-	struct thread *not_full;    /* Thread waiting for not-full condition. */
-	struct thread *not_empty;   /* Thread waiting for not-empty condition. */
+	struct waitqueue not_full;  /* Threads waiting for not-full condition. */
+	struct waitqueue not_empty; /* Threads waiting for not-empty condition. */
+	struct spinlock buf_lock;   /* Protects everything. */
 
 	/* Queue. */
 	uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
@@ -0,0 +1,23 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdint.h>
+
+/* Interrupt vectors used with the local APIC.  Vectors
+   LAPIC_VEC_FIRST through LAPIC_VEC_LAST are external interrupts
+   that are acknowledged on the local APIC. */
+#define LAPIC_VEC_FIRST 0xf0
+#define LAPIC_VEC_TICK 0xf0             /* Timer tick, sent by the BSP. */
+#define LAPIC_VEC_RESCHEDULE 0xf1       /* Run queue changed. */
+#define LAPIC_VEC_FLUSH_TLB 0xf2        /* Kernel mappings changed. */
+#define LAPIC_VEC_LAST 0xfe
+#define LAPIC_VEC_SPURIOUS 0xff         /* Spurious interrupt. */
+
+void lapic_init (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_broadcast_ipi (uint8_t vec);
+void lapic_start_aps (uint8_t page);
+
+#endif /* devices/lapic.h */
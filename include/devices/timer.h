@@ -2,13 +2,20 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
+uint64_t timer_tsc_hz (void);
+int64_t timer_cycles_to_us (uint64_t cycles);
+void timer_idle_enter (void);
+void timer_idle_exit (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
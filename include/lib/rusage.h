@@ -0,0 +1,19 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Whose usage getrusage() reports. */
+#define RUSAGE_SELF 0               /* The calling process. */
+#define RUSAGE_CHILDREN (-1)        /* Children it has waited for. */
+
+/* Resource usage, as reported by getrusage(). */
+struct rusage {
+	int64_t utime;              /* Time in user mode, in microseconds. */
+	int64_t stime;              /* Time in the kernel, in microseconds. */
+	int64_t nvcsw;              /* Context switches by blocking. */
+	int64_t nivcsw;             /* Context switches by preemption. */
+	int64_t faults;             /* Page faults. */
+};
+
+#endif /* lib/rusage.h */
@@ -36,6 +36,17 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduling. */
+	SYS_SET_DEADLINE,           /* Join or leave the deadline class. */
+	SYS_GETRUSAGE,              /* Report CPU usage. */
+	SYS_UPTIME,                 /* Report time since boot. */
+
+	/* User-space synchronization. */
+	SYS_FUTEX_WAIT,             /* Sleep on an int in user memory. */
+	SYS_FUTEX_WAKE,             /* Wake up threads sleeping on an int. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_JOIN,            /* Wait for such a thread to exit. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,23 @@
+#ifndef __LIB_USER_MUTEX_H
+#define __LIB_USER_MUTEX_H
+
+#include <stdbool.h>
+
+/* Mutex for user programs, built on futex_wait() and
+   futex_wake().  Locking and unlocking a mutex that nobody else
+   wants takes no system call. */
+struct mutex {
+	int state;                  /* 0: unlocked.
+	                               1: locked, nobody waiting.
+	                               2: locked, maybe someone waiting. */
+};
+
+/* Initializer for a mutex that is unlocked. */
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+#endif /* lib/user/mutex.h */
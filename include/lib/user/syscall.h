@@ -4,11 +4,21 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Identifier of a thread within a process. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+/* Function a thread runs.  Its return value becomes the
+   thread's exit status. */
+typedef int thread_func (void *aux);
+
 /* Map region identifier. */
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
@@ -50,6 +60,19 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Scheduling. */
+bool set_deadline (int64_t runtime, int64_t period);
+int getrusage (int who, struct rusage *usage);
+int64_t uptime (void);
+
+/* User-space synchronization. */
+int futex_wait (int *addr, int expected, int timeout_ms);
+int futex_wake (int *addr, int cnt);
+
+/* Threads. */
+tid_t thread_create (thread_func *, void *aux);
+int thread_join (tid_t);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -0,0 +1,94 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, for the 4.4BSD scheduler.
+
+   A fixed_t holds a real number X as the integer X * FP_F, that
+   is, with 17 bits before the binary point and 14 bits after it
+   (plus the sign bit).  The largest representable value is a
+   little under 131,072.
+
+   Adding or subtracting two fixed_t values, and multiplying or
+   dividing a fixed_t by an integer, works on the raw values.
+   Multiplying or dividing two fixed_t values has to widen to 64
+   bits first so that the intermediate result cannot overflow.
+
+   Only the kernel's scheduler needs these, and the kernel is
+   built without floating-point support, which is why real
+   numbers are not used directly. */
+
+typedef int32_t fixed_t;
+
+#define FP_P 17                         /* Bits before the point. */
+#define FP_Q 14                         /* Bits after the point. */
+#define FP_F (1 << FP_Q)                /* Fixed-point 1. */
+
+/* Converts integer N to fixed point. */
+static inline fixed_t
+fp_from_int (int n) {
+	return n * FP_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fp_to_int (fixed_t x) {
+	return x / FP_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fp_round (fixed_t x) {
+	return x >= 0 ? (x + FP_F / 2) / FP_F : (x - FP_F / 2) / FP_F;
+}
+
+/* Returns X + Y. */
+static inline fixed_t
+fp_add (fixed_t x, fixed_t y) {
+	return x + y;
+}
+
+/* Returns X - Y. */
+static inline fixed_t
+fp_sub (fixed_t x, fixed_t y) {
+	return x - y;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_t
+fp_add_int (fixed_t x, int n) {
+	return x + n * FP_F;
+}
+
+/* Returns X - N, for integer N. */
+static inline fixed_t
+fp_sub_int (fixed_t x, int n) {
+	return x - n * FP_F;
+}
+
+/* Returns X * Y. */
+static inline fixed_t
+fp_mul (fixed_t x, fixed_t y) {
+	return ((int64_t) x) * y / FP_F;
+}
+
+/* Returns X * N, for integer N. */
+static inline fixed_t
+fp_mul_int (fixed_t x, int n) {
+	return x * n;
+}
+
+/* Returns X / Y. */
+static inline fixed_t
+fp_div (fixed_t x, fixed_t y) {
+	return ((int64_t) x) * FP_F / y;
+}
+
+/* Returns X / N, for integer N. */
+static inline fixed_t
+fp_div_int (fixed_t x, int n) {
+	return x / n;
+}
+
+#endif /* threads/fixed-point.h */
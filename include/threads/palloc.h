@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -11,6 +12,36 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* Number of buddy allocator block orders.  The largest block is
+   2**(PALLOC_ORDERS - 1) pages, or 2 GB. */
+#define PALLOC_ORDERS 20
+
+/* Most free pages a CPU keeps for each pool. */
+#define MAGAZINE_MAX 32
+
+/* Pages moved between a magazine and its pool at once. */
+#define MAGAZINE_BATCH 16
+
+/* A CPU's cache of free single pages from one pool.  Owned by
+   palloc.c and only touched by its CPU, with interrupts off, so
+   it needs no lock. */
+struct page_magazine {
+	void *pages[MAGAZINE_MAX];  /* Free pages, most recently freed last. */
+	int cnt;                    /* Number of pages in pages[]. */
+	long long hits;             /* Allocations served from pages[]. */
+	long long refills;          /* Batches taken from the pool. */
+	long long misses;           /* Refills that found the pool empty. */
+	long long drains;           /* Batches given back to the pool. */
+};
+
+/* How a pool's pre-zeroed pages are doing.  See
+   palloc_get_zero_stats(). */
+struct palloc_zero_stats {
+	size_t ready;               /* Pre-zeroed pages waiting. */
+	long long idle_zeroed;      /* Pages zeroed by idle CPUs. */
+	long long hits;             /* PAL_ZERO pages that were pre-zeroed. */
+};
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
@@ -19,5 +50,9 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_zero_idle (void);
+void palloc_get_free_blocks (enum palloc_flags, size_t cnt[PALLOC_ORDERS]);
+void palloc_get_zero_stats (enum palloc_flags, struct palloc_zero_stats *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,34 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Longest cache name kmem_print_stats() shows, plus a null. */
+#define KMEM_NAME_LEN 24
+
+/* Object constructor.  Puts a newly carved-out object into the
+   state kmem_cache_alloc() hands it out in.  Must not sleep. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache;
+
+/* A cache's statistics.  See kmem_cache_get_stats(). */
+struct kmem_stats {
+	size_t obj_cnt;             /* Objects per slab. */
+	size_t slab_cnt;            /* Slabs the cache holds now. */
+	size_t created_cnt;         /* Slabs ever created. */
+	size_t in_use;              /* Objects allocated and not freed. */
+	size_t cached;              /* Free objects in CPUs' magazines. */
+};
+
+void kmem_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+struct kmem_cache *kmem_cache_of (const void *);
+size_t kmem_cache_size (const struct kmem_cache *);
+void kmem_cache_get_stats (struct kmem_cache *, struct kmem_stats *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,107 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Maximum number of CPUs. */
+#define CPU_MAX 16
+
+/* Physical address to which the application processor startup
+   code is copied.  An AP starts out in real mode at the page
+   named by the startup IPI, so this must be page aligned and
+   below 1 MB, and it must not overlap the loader. */
+#define AP_TRAMPOLINE 0x8000
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+#include <list.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+struct task_state;
+
+/* Per-CPU state.
+
+   The first three members are located by syscall-entry.S
+   through the kernel GS base, which points to this CPU's struct
+   cpu, so they must stay where they are. */
+struct cpu {
+	/* Owned by userprog/syscall-entry.S. */
+	uint64_t syscall_scratch[2];        /* Offsets 0 and 8. */
+	struct task_state *tss;             /* Offset 16. */
+
+	int id;                             /* Index in cpus[]; 0 is the BSP. */
+	uint8_t apic_id;                    /* Local APIC ID. */
+	volatile bool started;              /* Done booting? */
+
+	/* Owned by thread.c, protected by sched_lock.  There is one
+	   FIFO list per priority level, and bit P of ready_mask is
+	   set iff ready_queues[P] is nonempty. */
+	struct thread *idle_thread;         /* This CPU's idle thread. */
+	struct thread *curr;                /* Running thread. */
+	struct list ready_queues[PRI_MAX + 1];
+	uint64_t ready_mask;
+	int ready_cnt;                      /* Threads in ready_queues. */
+	struct heap fair_queue;             /* Ready threads under -fair,
+	                                       instead of ready_queues. */
+	uint64_t fair_weight;               /* Total weight in fair_queue. */
+	uint64_t min_vruntime;              /* Monotonic floor of vruntime. */
+	struct heap dl_queue;               /* Runnable deadline threads,
+	                                       earliest deadline on top. */
+	struct heap dl_throttled;           /* Deadline threads out of budget,
+	                                       earliest deadline on top. */
+	int dl_cnt;                         /* Threads in dl_queue. */
+	uint64_t dl_util;                   /* Utilization admitted here, in
+	                                       units of DL_UTIL_ONE.  Only
+	                                       changed by this CPU. */
+	long long idle_steals;              /* Threads stolen while idle. */
+	long long balance_pulls;            /* Threads pulled by the balancer. */
+	long long migrations_out;           /* Threads taken by other CPUs. */
+
+	/* Owned by thread.c, only touched by this CPU. */
+	unsigned thread_ticks;              /* Timer ticks since last yield. */
+	unsigned time_slice;                /* Ticks the running thread gets. */
+	unsigned balance_ticks;             /* Timer ticks since last balance. */
+	long long idle_ticks;               /* Timer ticks spent idle. */
+	long long kernel_ticks;             /* Timer ticks in kernel threads. */
+	long long user_ticks;               /* Timer ticks in user programs. */
+
+	/* Owned by interrupt.c. */
+	bool in_external_intr;              /* Handling external interrupt? */
+	bool yield_on_return;               /* Yield on interrupt return? */
+
+	/* Owned by userprog/fpu.c. */
+	struct thread *fpu_owner;           /* Thread whose FPU state was
+	                                       last loaded here. */
+
+	/* Owned by palloc.c, only touched by this CPU. */
+	struct page_magazine magazines[2];  /* Kernel pool, then user pool. */
+
+	/* Owned by smp.c, only written by this CPU. */
+	uint64_t tlb_gen;                   /* TLB shootdown generation this
+	                                       CPU has flushed up to. */
+};
+
+/* All CPUs.  cpus[0] is the bootstrap processor, and cpus[1]
+   through cpus[cpu_cnt - 1] are the application processors that
+   came up. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* Returns the CPU we are running on.
+   Every thread records the CPU it runs on in its struct thread,
+   which is at the bottom of the page holding the stack, so this
+   works the same way as thread_current(). */
+static inline struct cpu *
+this_cpu (void) {
+	return ((struct thread *) pg_round_down (rrsp ()))->cpu;
+}
+
+void smp_init (void);
+void smp_reschedule (struct cpu *);
+void smp_broadcast_tick (void);
+void smp_flush_tlb (void);
+
+#endif /* __ASSEMBLER__ */
+#endif /* threads/smp.h */
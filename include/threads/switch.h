@@ -0,0 +1,13 @@
+#ifndef THREADS_SWITCH_H
+#define THREADS_SWITCH_H
+
+#include <stdint.h>
+
+struct intr_frame;
+
+/* Switches from the running thread to another kernel thread.
+   See threads/switch.S. */
+void thread_switch (uint64_t *prev_rsp, uint64_t next_rsp,
+                    struct intr_frame *next_tf);
+
+#endif /* threads/switch.h */
@@ -1,41 +1,168 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+struct cpu;
+
+#ifdef LOCKSTAT
+/* Contention statistics, kept when the kernel is built with
+   LOCKSTAT defined (`make LOCKSTAT=1').  All the spinlocks,
+   semaphores or locks initialized at one place in the source
+   share one lock_stat, named after the initializer's argument,
+   so that, say, every thread's load_sema adds up in one line of
+   lock_print_stats().  Times are in TSC cycles. */
+struct lock_stat {
+	const char *name;           /* Initializer's argument. */
+	const char *file;           /* Where it was initialized. */
+	int line;
+	int registered;             /* On the list of all lock_stats? */
+	struct lock_stat *next;     /* Next on that list. */
+	uint64_t acquisitions;      /* Times acquired or downed. */
+	uint64_t contended;         /* Times that had to wait. */
+	uint64_t wait_cycles;       /* Total time spent waiting. */
+	uint64_t wait_max;          /* Longest single wait. */
+	uint64_t hold_cycles;       /* Total time held (not semaphores). */
+};
+#endif
+
+/* Spinlock.
+
+   Protects data shared between CPUs for short stretches of code
+   that must not sleep.  A spinlock must only be acquired with
+   interrupts off, or an interrupt handler on the same CPU could
+   spin forever on a lock that its own CPU holds.  Spinlocks are
+   not recursive. */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+	struct cpu *holder;         /* CPU holding the lock (for debugging). */
+#ifdef LOCKSTAT
+	struct lock_stat *stat;     /* Statistics, or null. */
+	uint64_t acquired_tsc;      /* When it was acquired. */
+#endif
+};
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
+/* Wait queue.
+
+   Threads sleep on a wait queue until somebody wakes them up or,
+   optionally, until a timeout, which goes through the same sleep
+   queue as timer_sleep().  The caller supplies a spinlock that
+   protects whatever condition the threads wait for.  It must be
+   held, with interrupts off, both to wait and to wake, so that a
+   wakeup cannot slip in between testing the condition and going
+   to sleep.  The queues themselves are protected by sched_lock.
+
+   An exclusive waiter is one of several that cannot all proceed
+   at once, like threads downing a semaphore.  Each wakeup takes
+   only the highest-priority exclusive waiter, in FIFO order among
+   equal priorities, in O(log n) time, instead of waking them all
+   to fight it out.  A waiter keeps its place by priority even if
+   its priority changes, say through donation, while it waits.
+   Non-exclusive waiters are all woken by every wakeup. */
+struct waitqueue {
+	struct heap exclusive;      /* Exclusive waiters, by priority. */
+	struct heap shared;         /* Non-exclusive waiters, by priority. */
+	uint64_t seq;               /* Stamps waiters in arrival order. */
+};
+
+void waitqueue_init (struct waitqueue *);
+void waitqueue_prepare (struct waitqueue *, bool exclusive);
+bool waitqueue_sleep (struct waitqueue *, struct spinlock *,
+                      int64_t end_tick);
+bool waitqueue_wait (struct waitqueue *, struct spinlock *,
+                     bool exclusive, int64_t end_tick);
+bool waitqueue_wake_one (struct waitqueue *);
+void waitqueue_wake_all (struct waitqueue *);
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	
-	// 이 waiters에는 이 semaphore에 관련하여 잠자고 있는 스레드 (struct thread의 elem 멤버)이 저장됨
-	struct list waiters;        /* List of waiting threads. */
-	
+	struct spinlock lock;       /* Protects value and waiters. */
+	struct waitqueue waiters;   /* Threads waiting for value > 0. */
+#ifdef LOCKSTAT
+	struct lock_stat *stat;     /* Statistics, or null. */
+#endif
+};
+/* A thread's hold on a lock or a reader-writer lock, as an
+   element of the holder's held_locks.  Protected by sched_lock. */
+struct lock_hold {
+	int max_priority;           /* Priority of the top donor as of the
+	                               last donation, or -1 if none. */
+	struct heap_elem elem;      /* Element in holder's held_locks. */
 };
+
 /* Lock. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+
+	/* Priority donation, protected by sched_lock. */
+	struct heap donors;         /* Waiting threads, highest priority on top. */
+	struct lock_hold hold;      /* Holder's hold. */
+#ifdef LOCKSTAT
+	struct lock_stat *stat;     /* Statistics, or null. */
+	uint64_t acquired_tsc;      /* When it was acquired. */
+#endif
+};
+
+/* Reader-writer lock.
+
+   Any number of threads may hold a reader-writer lock shared, or
+   one thread may hold it exclusive.  Writers are preferred: while
+   a writer waits, new readers wait behind it, so a steady stream
+   of readers cannot starve writers.  Threads that wait donate
+   their priority to every holder, as with locks.  Reader-writer
+   locks are not recursive, not even for readers, since a second
+   shared acquisition would wait behind any waiting writer. */
+struct rwlock {
+	struct spinlock lock;       /* Protects the members below, except
+	                               that changing writer also takes
+	                               sched_lock. */
+	int readers;                /* Threads holding it shared. */
+	struct thread *writer;      /* Thread holding it exclusive, or null. */
+	int writers_waiting;        /* Writers that want it. */
+	struct list read_waiters;   /* Readers sleeping on it. */
+	struct list write_waiters;  /* Writers sleeping on it. */
+
+	/* Priority donation, protected by sched_lock. */
+	struct heap donors;         /* Waiting threads, highest priority on top. */
+	int max_priority;           /* Priority of the top donor as of the
+	                               last donation, or -1 if none. */
+	struct list holds;          /* Readers' rwlock_holds. */
+	struct lock_hold writer_hold; /* Writer's hold. */
+};
+
+/* Most reader-writer locks a thread may hold shared at once. */
+#define RWLOCK_SHARED_MAX 4
+
+/* A thread's shared hold on a reader-writer lock.  Each thread
+   has RWLOCK_SHARED_MAX of these. */
+struct rwlock_hold {
+	struct rwlock *rwlock;      /* Lock held, or null if unused. */
+	struct thread *thread;      /* Holder. */
+	struct list_elem elem;      /* Element in rwlock's holds. */
+	struct lock_hold hold;      /* Donations through rwlock. */
 };
 
 /* Condition variable. */
 // 각 공유 자원마다 하나씩 가짐. 공유 자원별로 따로따로 하나씩 갖고 있어야 함.
 struct condition {
-	// 이 waiters에는 조건이 충족될 때까지 기다리는 세마포어들이 저장됨.
-	struct list waiters;        /* List of waiting threads. */
-};
-
-/* 참고용: synch.c의 semaphore_elem
-// 현재 스레드가 사용할 "자기 전용 이진 세마포어".
-struct semaphore_elem {
-	// 참고: elem의 멤버는 struct list_elem *prev, *next;
-	struct list_elem elem;      
-	struct semaphore semaphore; 
+	struct spinlock lock;       /* Protects waiters. */
+	// 이 waiters에는 조건이 충족될 때까지 기다리는 스레드들이 우선순위 순으로 저장됨.
+	struct waitqueue waiters;   /* Waiting threads. */
 };
-*/
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
+bool sema_down_timeout (struct semaphore *, int64_t ticks);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
@@ -46,17 +173,45 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_shared (struct rwlock *);
+void rwlock_release_shared (struct rwlock *);
+void rwlock_acquire_exclusive (struct rwlock *);
+void rwlock_release_exclusive (struct rwlock *);
+
 void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
 /*-- Priority condvar 구현 --*/
-bool sema_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux );
-bool donation_priority_cmp(const struct list_elem *a,
-						   const struct list_elem *b, void *aux);
+bool held_lock_less (const struct heap_elem *a, const struct heap_elem *b,
+                     void *aux);
 /*-- Priority condvar 구현 --*/
 
+#ifdef LOCKSTAT
+void spinlock_init_stat (struct spinlock *, struct lock_stat *);
+void sema_init_stat (struct semaphore *, unsigned value, struct lock_stat *);
+void lock_init_stat (struct lock *, struct lock_stat *);
+void lock_print_stats (void);
+
+/* Give every initialization site its own lock_stat. */
+#define LOCK_STAT_INIT(NAME) \
+	{ .name = (NAME), .file = __FILE__, .line = __LINE__ }
+#define spinlock_init(LOCK) do {                                     \
+		static struct lock_stat stat_ = LOCK_STAT_INIT (#LOCK);      \
+		spinlock_init_stat ((LOCK), &stat_);                         \
+	} while (0)
+#define sema_init(SEMA, VALUE) do {                                  \
+		static struct lock_stat stat_ = LOCK_STAT_INIT (#SEMA);      \
+		sema_init_stat ((SEMA), (VALUE), &stat_);                    \
+	} while (0)
+#define lock_init(LOCK) do {                                         \
+		static struct lock_stat stat_ = LOCK_STAT_INIT (#LOCK);      \
+		lock_init_stat ((LOCK), &stat_);                             \
+	} while (0)
+#endif
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -2,8 +2,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
+#include <rusage.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h" // Project 2. User Programs 구현
 
@@ -30,12 +33,28 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the 4.4BSD scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
+struct cpu;
+
 /*-- Project 2. User Programs 과제. --*/
 // for system call
 #define FDT_PAGES 2                       // FDT 할당을 위한 페이지수. (thread_create, process_exit 등)
 #define FDCOUNT_LIMIT FDT_PAGES*(1 << 8)  // FD의 idx를 제한. 동료 리뷰 결과 보통 256-1536 정도의 값을 잡는 듯. 그러나 32 같은 적은 수에서도 multi-oom이 통과되어야 정상.
 /*-- Project 2. User Programs 과제. --*/
 
+/* CPU usage of a thread, or of the children it has waited for. */
+struct thread_usage {
+	uint64_t user_cycles;               /* TSC cycles in user mode. */
+	uint64_t kernel_cycles;             /* TSC cycles in the kernel. */
+	uint32_t nvcsw;                     /* Times it blocked. */
+	uint32_t nivcsw;                    /* Times it was preempted. */
+	uint32_t faults;                    /* Page faults. */
+};
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -89,23 +108,36 @@ typedef int tid_t;
  * value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
  * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+ * reader-writer lock's wait list (synch.c).  It can be used these
+ * two ways only because they are mutually exclusive: only a
+ * thread in the ready state is on the run queue, whereas only a
+ * thread in the blocked state is on a wait list.  Wait queues
+ * use `wait_elem' instead, since a thread whose wait times out
+ * goes back on the run queue before it leaves its wait queue. */
 struct thread {
 	/* Owned by thread.c. */
 	tid_t tid;                          /* Thread identifier. */
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	struct cpu *cpu;                    /* CPU whose run queue it is on,
+	                                       or last ran on. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
+	struct waitqueue *waitq;            /* Wait queue it is on, or null. */
+	struct heap_elem wait_elem;         /* Element in waitq. */
+	uint64_t wait_seq;                  /* Arrival order in waitq. */
+	bool wait_exclusive;                /* Exclusive waiter in waitq? */
 
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+
+	/* Owned by userprog/fpu.c. */
+	void *fpu_state;                    /* Saved FPU state, or null
+	                                       if the FPU was never used. */
+	struct cpu *fpu_cpu;                /* CPU that last loaded it. */
 #endif
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
@@ -114,20 +146,55 @@ struct thread {
 #endif
 
 	/* Owned by thread.c. */
-	struct intr_frame tf;               /* Information for switching */
+	struct intr_frame tf;               /* Context for first launch. */
+	uint64_t switch_rsp;                /* Saved stack pointer while
+	                                       switched out, or 0 if the
+	                                       thread has never run. */
 	unsigned magic;                     /* Detects stack overflow. */
     
 	/*-- Alarm clock 과제  --*/
 	int64_t wakeup_tick; // Alarm clock 과제 - 어느 틱에 깨울지.
+	struct heap_elem sleep_elem; // sleep queue(wakeup_tick 기준 min-heap)의 노드
+	bool timed_block; // thread_block_until()로 잠들어 아직 깨어나지 않았는지
 	/*-- Alarm clock 과제  --*/
 
 	/*-- Priority donation 과제 --*/
 	int original_priority;
     struct lock *wait_lock;
-    struct list donations;
-    struct list_elem donation_elem;
+	struct heap held_locks;             // 보유한 락들. 락의 max_priority 기준 max-heap
+	struct heap_elem donor_elem;        // wait_lock->donors 또는 wait_rwlock->donors의 노드
+	struct rwlock *wait_rwlock;         // 기다리는 reader-writer 락
+	struct rwlock_hold shared_holds[RWLOCK_SHARED_MAX]; // shared로 보유한 reader-writer 락들
 	/*-- Priority donation 과제 --*/
 
+	/*-- Advanced scheduler 과제 --*/
+	int nice;                           /* Niceness, NICE_MIN..NICE_MAX. */
+	fixed_t recent_cpu;                 /* Recently used CPU time. */
+	bool mlfqs_active;                  /* In mlfqs_threads? */
+	bool mlfqs_dirty;                   /* In mlfqs_dirty? */
+	struct list_elem mlfqs_elem;        /* mlfqs_threads element. */
+	struct list_elem mlfqs_dirty_elem;  /* mlfqs_dirty element. */
+	/*-- Advanced scheduler 과제 --*/
+
+	/* Owned by thread.c, for the proportional-share scheduler. */
+	uint64_t vruntime;                  /* Weighted CPU time received. */
+	struct heap_elem fair_elem;         /* Element in cpu's fair_queue. */
+
+	/* Owned by thread.c, for the deadline class. */
+	int64_t dl_runtime;                 /* Budget per period, in ticks. */
+	int64_t dl_period;                  /* Period in ticks, or 0 if not
+	                                       a deadline thread. */
+	int64_t dl_deadline;                /* Absolute deadline, in ticks. */
+	int64_t dl_budget;                  /* Runtime left until then. */
+	bool dl_throttled;                  /* Out of budget until deadline? */
+	struct heap_elem dl_elem;           /* Element in cpu's dl_queue or
+	                                       dl_throttled. */
+
+	/* Owned by thread.c, for CPU accounting. */
+	uint64_t acct_tsc;                  /* TSC when usage was last charged. */
+	struct thread_usage usage;          /* Own usage. */
+	struct thread_usage child_usage;    /* Reaped children's, summed. */
+
 	/*-- Project 2. User Programs 과제 --*/
 	int exit_status;
 	struct file **fd_table;
@@ -142,25 +209,67 @@ struct thread {
 	struct semaphore wait_sema; // 부모가 자식의 종료를 기다릴 수 있도록 하기 위한 세마포어
  
 	struct file *running; // 현재 실행 중인 파일
+
+	// 한 프로세스 안의 스레드들 (thread_create 시스템 콜)
+	struct thread *leader;         // 주소 공간, SPT, fd 테이블의 주인인 프로세스의 첫 스레드. 첫 스레드는 자기 자신
+	int stack_slot;                // 유저 스택 슬롯 번호 (첫 스레드가 아닐 때)
+	struct lock thread_lock;       // 아래 넷을 보호. 리더의 것만 사용
+	struct condition threads_done; // thread_cnt가 0이 되면 시그널
+	int thread_cnt;                // 살아있는 다른 스레드 수
+	uint32_t stack_slots;          // 사용 중인 스택 슬롯들의 비트맵
+	uint32_t stacks_mapped;        // 한 번이라도 스택을 만들어 둔 슬롯들의 비트맵
 	/*-- Project 2. User Programs 과제 --*/
 };
 
+/* Cost of maintaining the sleep queue, measured in TSC cycles
+   spent with interrupts off.  See thread_get_sleep_stats(). */
+struct sleep_stats {
+	uint64_t insert_cnt;        /* Number of thread_sleep() calls. */
+	uint64_t insert_cycles;     /* Total cycles spent inserting. */
+	uint64_t insert_max;        /* Longest single insertion. */
+	uint64_t tick_cnt;          /* Number of timer ticks checked. */
+	uint64_t tick_cycles;       /* Total cycles checking and waking. */
+	uint64_t tick_max;          /* Longest single tick. */
+};
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the proportional-share scheduler.
+   Controlled by kernel command-line option "-fair". */
+extern bool thread_fair;
+
+/* Protects the scheduler state of every CPU. */
+extern struct spinlock sched_lock;
+
 void thread_init (void);
 void thread_start (void);
+void *thread_init_ap (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
+bool thread_cpus_idle (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
 
+void thread_charge_user (void);
+void thread_charge_kernel (void);
+void thread_reap_usage (struct thread *child);
+int thread_get_rusage (int who, struct rusage *);
+
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_on (struct cpu *, const char *name, int priority,
+                        thread_func *, void *);
+void thread_put_fd_table (struct file **);
 
 void thread_block (void);
+void thread_block_locked (struct spinlock *);
+void thread_block_until (struct spinlock *, int64_t end_tick);
 void thread_unblock (struct thread *);
+void thread_wake (struct thread *);
+void thread_wake_locked (struct thread *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -170,10 +279,26 @@ void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 
 bool thread_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-bool thread_wakeup_tick_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+
+/*-- Alarm clock 과제 --*/
+void thread_sleep (int64_t end_tick);
+void thread_check_sleep_list (void);
+int64_t thread_next_wakeup (void);
+void thread_get_sleep_stats (struct sleep_stats *);
+void thread_reset_sleep_stats (void);
+/*-- Alarm clock 과제 --*/
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_set_effective_priority (struct thread *, int);
+bool thread_set_deadline (int64_t runtime, int64_t period);
+
+/*-- Priority donation 과제 --*/
+void donate_priority (void);
+bool donate_to_hold (struct thread *, struct lock_hold *, int priority);
+void refresh_priority (void);
+void check_and_preempt (void);
+/*-- Priority donation 과제 --*/
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -0,0 +1,37 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler events recorded in the trace. */
+enum trace_type {
+	TRACE_SWITCH,               /* Switched to TID from thread ARG. */
+	TRACE_WAKEUP,               /* TID made ready on CPU ARG. */
+	TRACE_BLOCK,                /* TID blocked. */
+	TRACE_SLEEP,                /* TID sleeps until tick ARG. */
+	TRACE_DONATE,               /* TID raised to priority ARG. */
+	TRACE_IRQ_ENTER,            /* Interrupt ARG arrived while TID ran. */
+	TRACE_IRQ_EXIT,             /* Interrupt ARG handled. */
+	TRACE_TYPE_CNT
+};
+
+/* Set by the kernel command-line option "-trace". */
+extern bool trace_enabled;
+
+/* True while events are being recorded. */
+extern bool trace_on;
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, int64_t arg);
+void trace_dump (void);
+
+/* Records an event of the given TYPE about thread TID, if
+   tracing is on.  Cheap enough to leave in hot paths. */
+static inline void
+trace (enum trace_type type, int tid, int64_t arg) {
+	if (trace_on)
+		trace_record (type, tid, arg);
+}
+
+#endif /* threads/trace.h */
@@ -0,0 +1,25 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel virtual addresses reserved for vmalloc(), well above the
+   direct mapping of physical memory that starts at KERN_BASE but
+   under the same page map level 4 entry. */
+#define VMALLOC_START (KERN_BASE + 0x4000000000ULL)
+#define VMALLOC_SIZE (256 * 1024 * 1024)
+#define VMALLOC_END (VMALLOC_START + VMALLOC_SIZE)
+
+/* Returns true if VADDR was handed out by vmalloc(). */
+#define is_vmalloc_vaddr(vaddr) \
+	((uint64_t) (vaddr) >= VMALLOC_START && (uint64_t) (vaddr) < VMALLOC_END)
+
+void vmalloc_init (void);
+void *vmalloc (size_t size);
+void vfree (void *);
+size_t vmalloc_size (const void *);
+
+#endif /* threads/vmalloc.h */
@@ -0,0 +1,14 @@
+#ifndef USERPROG_FPU_H
+#define USERPROG_FPU_H
+
+#include <stdbool.h>
+#include "threads/thread.h"
+
+void fpu_init (void);
+void fpu_init_cpu (void);
+void fpu_switch (struct thread *prev, struct thread *next);
+void fpu_save_current (void);
+bool fpu_fork (struct thread *child, struct thread *parent);
+void fpu_discard (void);
+
+#endif /* userprog/fpu.h */
@@ -0,0 +1,10 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+void futex_init (void);
+int futex_wait (int *uaddr, int expected, int timeout_ms);
+int futex_wake (int *uaddr, int cnt);
+
+#endif /* userprog/futex.h */
@@ -7,10 +7,13 @@
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
+tid_t process_thread_create (void *entry, uint64_t arg1, uint64_t arg2,
+		struct intr_frame *if_);
+int process_thread_join (tid_t);
 int process_add_file(struct file *file_obj);
 struct file *process_get_file_by_fd(int fd);
 struct thread *process_get_child(int pid);
-void process_close_file_by_id(int fd);
+struct file *process_close_file_by_id(int fd);
 void argument_stack(char **argv, int argc, void **rsp) ;
 int process_exec (void *f_name);
 int process_wait (tid_t);
@@ -2,6 +2,7 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void syscall_init_cpu (void);
 
 void seek(int fd, unsigned position);
 void exit(int status) ;
@@ -13,8 +14,4 @@ void close(int fd);
 int filesize(int fd);
 int read(int fd, void *buffer, unsigned size);
 
-/* 전역 변수 ~ */
-struct lock g_filesys_lock;
-/* ~ 전역 변수 */
-
 #endif /* userprog/syscall.h */
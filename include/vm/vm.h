@@ -14,6 +14,11 @@
 /* 전역 변수 ~ */
 static struct list g_frame_table;
 static struct lock g_frame_lock;
+
+// struct page, struct frame, struct file_lazy_aux 전용 객체 캐시 (threads/slab.h)
+extern struct kmem_cache *page_struct_cache;
+extern struct kmem_cache *frame_struct_cache;
+extern struct kmem_cache *lazy_aux_cache;
 /* ~ 전역 변수 */
 
 struct file_lazy_aux {
@@ -109,7 +114,7 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	// struck lock lpt
+	struct lock lock;       // 같은 프로세스의 스레드들이 공유하므로 main_table과 페이지 클레임을 보호
 	struct hash main_table;
 };
 
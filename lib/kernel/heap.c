@@ -0,0 +1,180 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a heap-ordered multiway tree.  Each node
+   keeps a pointer to its leftmost child, and the children of a
+   node form a doubly linked sibling list whose first element's
+   `prev' points back to the parent:
+
+       root
+        |
+        v
+       [A] <--> [B] <--> [C]
+        |                 |
+        v                 v
+       [D]               [E] <--> [F]
+
+   Two heaps are merged ("linked") by making the root that
+   compares greater the leftmost child of the other one, which
+   takes constant time.  Removing the top combines the root's
+   children pairwise from left to right and then merges the
+   pairs from right to left, which gives O(log n) amortized
+   time.  Both passes below are iterative, so there is no
+   recursion on the (small) kernel stack. */
+
+/* Links the two heap roots A and B and returns the new root. */
+static struct heap_elem *
+link (struct heap *heap, struct heap_elem *a, struct heap_elem *b) {
+	if (heap->less (b, a, heap->aux)) {
+		struct heap_elem *t = a;
+		a = b;
+		b = t;
+	}
+
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	a->next = a->prev = NULL;
+	return a;
+}
+
+/* Combines the sibling list starting at FIRST into a single heap
+   and returns its root. */
+static struct heap_elem *
+combine (struct heap *heap, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* Left to right: link adjacent pairs, stacking the results
+	   on PAIRS through their `next' members. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+		struct heap_elem *merged;
+
+		if (b != NULL) {
+			first = b->next;
+			a->next = a->prev = b->next = b->prev = NULL;
+			merged = link (heap, a, b);
+		} else {
+			first = NULL;
+			a->prev = NULL;
+			merged = a;
+		}
+		merged->next = pairs;
+		pairs = merged;
+	}
+
+	/* Right to left: fold the stacked pairs into one heap. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+		pairs->next = NULL;
+		root = root != NULL ? link (heap, root, pairs) : pairs;
+		pairs = next;
+	}
+	return root;
+}
+
+/* Initializes HEAP as an empty heap ordered by LESS given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *heap, heap_less_func *less, void *aux) {
+	ASSERT (heap != NULL);
+	ASSERT (less != NULL);
+
+	heap->root = NULL;
+	heap->size = 0;
+	heap->less = less;
+	heap->aux = aux;
+}
+
+/* Inserts ELEM into HEAP. */
+void
+heap_push (struct heap *heap, struct heap_elem *elem) {
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+
+	elem->child = elem->next = elem->prev = NULL;
+	heap->root = heap->root != NULL ? link (heap, heap->root, elem) : elem;
+	heap->size++;
+}
+
+/* Returns the top element of HEAP, or a null pointer if HEAP is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root;
+}
+
+/* Removes and returns the top element of HEAP, or returns a null
+   pointer if HEAP is empty. */
+struct heap_elem *
+heap_pop (struct heap *heap) {
+	struct heap_elem *top;
+
+	ASSERT (heap != NULL);
+
+	top = heap->root;
+	if (top != NULL) {
+		heap->root = combine (heap, top->child);
+		heap->size--;
+		top->child = top->next = top->prev = NULL;
+	}
+	return top;
+}
+
+/* Removes ELEM, which must be in HEAP, from HEAP. */
+void
+heap_remove (struct heap *heap, struct heap_elem *elem) {
+	struct heap_elem *subtree;
+
+	ASSERT (heap != NULL);
+	ASSERT (elem != NULL);
+	ASSERT (heap->size > 0);
+
+	if (elem == heap->root) {
+		heap_pop (heap);
+		return;
+	}
+
+	/* Unlink ELEM, with its subtree, from its sibling list. */
+	ASSERT (elem->prev != NULL);
+	if (elem->prev->child == elem)
+		elem->prev->child = elem->next;
+	else
+		elem->prev->next = elem->next;
+	if (elem->next != NULL)
+		elem->next->prev = elem->prev;
+
+	/* Merge ELEM's children back into the heap. */
+	subtree = combine (heap, elem->child);
+	if (subtree != NULL)
+		heap->root = link (heap, heap->root, subtree);
+	heap->size--;
+	elem->child = elem->next = elem->prev = NULL;
+}
+
+/* Restores the heap order after the value that HEAP's ordering
+   depends on has changed for ELEM, which must be in HEAP. */
+void
+heap_update (struct heap *heap, struct heap_elem *elem) {
+	heap_remove (heap, elem);
+	heap_push (heap, elem);
+}
+
+/* Returns the number of elements in HEAP. */
+size_t
+heap_size (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->size;
+}
+
+/* Returns true if HEAP is empty, false otherwise. */
+bool
+heap_empty (const struct heap *heap) {
+	ASSERT (heap != NULL);
+	return heap->root == NULL;
+}
@@ -0,0 +1,46 @@
+#include <mutex.h>
+#include <syscall.h>
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Locks M, sleeping in the kernel while another thread holds
+   it. */
+void
+mutex_lock (struct mutex *m) {
+	int c = 0;
+
+	if (__atomic_compare_exchange_n (&m->state, &c, 1, false,
+	                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	/* Contended.  Mark M as having a waiter, so that the holder
+	   wakes us up, and sleep until we find M unlocked. */
+	if (c != 2)
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex_wait (&m->state, 2, -1);
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Locks M if it is unlocked.  Returns true if successful, false
+   if another thread holds M. */
+bool
+mutex_trylock (struct mutex *m) {
+	int c = 0;
+
+	return __atomic_compare_exchange_n (&m->state, &c, 1, false,
+	                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Unlocks M, which the running thread must hold, and wakes up a
+   thread waiting for it, if there may be one. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_exchange_n (&m->state, 0, __ATOMIC_RELEASE) == 2)
+		futex_wake (&m->state, 1);
+}
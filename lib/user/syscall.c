@@ -194,3 +194,45 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+bool
+set_deadline (int64_t runtime, int64_t period) {
+	return syscall2 (SYS_SET_DEADLINE, runtime, period);
+}
+
+int
+getrusage (int who, struct rusage *usage) {
+	return syscall2 (SYS_GETRUSAGE, who, usage);
+}
+
+int64_t
+uptime (void) {
+	return syscall0 (SYS_UPTIME);
+}
+
+int
+futex_wait (int *addr, int expected, int timeout_ms) {
+	return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (int *addr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+/* Where a thread made by thread_create() starts.  Calling exit()
+   from it ends only that thread. */
+static void
+thread_start (thread_func *func, void *aux) {
+	exit (func (aux));
+}
+
+tid_t
+thread_create (thread_func *func, void *aux) {
+	return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+int
+thread_join (tid_t tid) {
+	return syscall1 (SYS_THREAD_JOIN, tid);
+}
@@ -0,0 +1,46 @@
+/* Child process for syn-read-bench test.
+   Reads its own test file PASS_CNT times, a sector at a time,
+   and checks the contents each time. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-read-bench.h"
+
+const char *test_name = "child-syn-read-bench";
+
+static char expected[BUF_SIZE];
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd;
+  int pass;
+  size_t ofs;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (child_idx);
+  random_bytes (expected, sizeof expected);
+
+  bench_file_name (name, child_idx);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (pass = 0; pass < PASS_CNT; pass++) 
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < sizeof buf; ofs += 512)
+        CHECK (read (fd, buf + ofs, 512) == 512, "read \"%s\"", name);
+      compare_bytes (buf, expected, sizeof buf, 0, name);
+    }
+  close (fd);
+
+  return child_idx;
+}
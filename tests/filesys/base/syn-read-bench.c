@@ -0,0 +1,47 @@
+/* Spawns 4 child processes that each read their own file over
+   and over, and reports the aggregate throughput.  With a lock
+   per inode, reads of different files do not wait for each
+   other.  The throughput is for comparison between locking
+   schemes; it is not checked. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-read-bench.h"
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int64_t start, elapsed;
+  long long bytes;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    {
+      char name[16];
+      int fd;
+
+      bench_file_name (name, i);
+      CHECK (create (name, sizeof buf), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      random_init (i);
+      random_bytes (buf, sizeof buf);
+      CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"%s\"", name);
+      msg ("close \"%s\"", name);
+      close (fd);
+    }
+
+  start = uptime ();
+  exec_children ("child-syn-read-bench", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  elapsed = uptime () - start;
+
+  bytes = (long long) CHILD_CNT * PASS_CNT * BUF_SIZE;
+  msg ("Read %lld bytes in %lld ms, %lld kB/s.", bytes, elapsed,
+       elapsed > 0 ? bytes * 1000 / 1024 / elapsed : 0);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "missing begin message\n"
+  if !grep (/^\(syn-read-bench\) begin$/, @output);
+fail "missing end message\n"
+  if !grep (/^\(syn-read-bench\) end$/, @output);
+for my $i (1...4) {
+    my ($expected) = $i - 1;
+    fail "child $i did not read its file correctly\n"
+      if !grep (/^\(syn-read-bench\) wait for child $i of 4 returned $expected \(expected $expected\)$/, @output);
+}
+fail "missing throughput\n"
+  if !grep (/^\(syn-read-bench\) Read 262144 bytes in \d+ ms, \d+ kB\/s\.$/,
+	    @output);
+pass;
@@ -0,0 +1,12 @@
+#ifndef TESTS_FILESYS_BASE_SYN_READ_BENCH_H
+#define TESTS_FILESYS_BASE_SYN_READ_BENCH_H
+
+#define BUF_SIZE 8192
+#define PASS_CNT 8
+#define CHILD_CNT 4
+
+/* Writes the name of child IDX's file into NAME. */
+#define bench_file_name(NAME, IDX) \
+  snprintf ((NAME), sizeof (NAME), "data%d", (int) (IDX))
+
+#endif /* tests/filesys/base/syn-read-bench.h */
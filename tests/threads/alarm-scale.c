@@ -0,0 +1,94 @@
+/* Creates 1000 threads that each sleep several times for
+   pseudo-random durations, checks that none of them wakes up
+   early, and reports how long interrupts were kept off to
+   maintain the sleep queue.  The cycle counts are for
+   comparison between sleep queue implementations; they are not
+   checked. */
+
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define ITERATIONS 5
+#define MAX_SLEEP 50
+
+/* Information about the test. */
+struct scale_test 
+  {
+    struct semaphore done;      /* Upped by each finished thread. */
+    struct lock lock;           /* Protects `early'. */
+    int early;                  /* Number of early wakeups. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_scale (void) 
+{
+  struct scale_test test;
+  struct sleep_stats stats;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d times each.",
+       THREAD_CNT, ITERATIONS);
+
+  sema_init (&test.done, 0);
+  lock_init (&test.lock);
+  test.early = 0;
+  random_init (0);
+  thread_reset_sleep_stats ();
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper, &test) == TID_ERROR)
+        fail ("thread_create() failed for thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&test.done);
+
+  msg ("All threads finished, %d woke up early.", test.early);
+
+  thread_get_sleep_stats (&stats);
+  msg ("Insert: %"PRIu64" calls, %"PRIu64" cycles average, "
+       "%"PRIu64" cycles max with interrupts off.",
+       stats.insert_cnt, stats.insert_cycles / stats.insert_cnt,
+       stats.insert_max);
+  msg ("Tick: %"PRIu64" ticks, %"PRIu64" cycles average, "
+       "%"PRIu64" cycles max with interrupts off.",
+       stats.tick_cnt, stats.tick_cnt ? stats.tick_cycles / stats.tick_cnt : 0,
+       stats.tick_max);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *test_) 
+{
+  struct scale_test *test = test_;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      int64_t duration = random_ulong () % MAX_SLEEP + 1;
+      int64_t wakeup = timer_ticks () + duration;
+
+      timer_sleep (duration);
+      if (timer_ticks () < wakeup) 
+        {
+          lock_acquire (&test->lock);
+          test->early++;
+          lock_release (&test->lock);
+        }
+    }
+  sema_up (&test->done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "missing begin message\n"
+  if !grep (/^\(alarm-scale\) begin$/, @output);
+fail "missing end message\n"
+  if !grep (/^\(alarm-scale\) end$/, @output);
+fail "some threads woke up early or never finished\n"
+  if !grep (/^\(alarm-scale\) All threads finished, 0 woke up early\.$/,
+	    @output);
+fail "missing sleep queue statistics\n"
+  if !grep (/^\(alarm-scale\) Insert: 5000 calls, \d+ cycles average, \d+ cycles max/, @output)
+     || !grep (/^\(alarm-scale\) Tick: \d+ ticks, \d+ cycles average, \d+ cycles max/, @output);
+pass;
@@ -0,0 +1,71 @@
+/* Runs with the -tickless kernel option.  Puts several threads to
+   sleep for durations longer than a single one-shot of the timer
+   can cover, while the CPU is otherwise idle, and checks that
+   each of them wakes up neither early nor late. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 5
+
+/* Sleep duration of each thread, in ticks. */
+static const int durations[THREAD_CNT] = {2, 7, 13, 50, 101};
+
+/* Result of each thread. */
+struct sleeper 
+  {
+    int id;                     /* Index into durations[]. */
+    int64_t slept;              /* Ticks actually slept. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_tickless (void) 
+{
+  struct sleeper sleepers[THREAD_CNT];
+  struct semaphore done;
+  int i;
+
+  ASSERT (timer_tickless);
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      sleepers[i].id = i;
+      sleepers[i].slept = 0;
+      sleepers[i].done = &done;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, &sleepers[i]);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      /* A tick may pass between reading the start time and going
+         to sleep, so allow one tick of slack. */
+      int64_t slept = sleepers[i].slept;
+      if (slept < durations[i] || slept > durations[i] + 1)
+        fail ("thread %d slept %lld ticks instead of %d",
+              i, (long long) slept, durations[i]);
+      msg ("thread %d woke up on time.", i);
+    }
+}
+
+static void
+sleeper (void *s_) 
+{
+  struct sleeper *s = s_;
+  int64_t start = timer_ticks ();
+
+  timer_sleep (durations[s->id]);
+  s->slept = timer_elapsed (start);
+  sema_up (s->done);
+}
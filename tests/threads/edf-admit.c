@@ -0,0 +1,108 @@
+/* Checks admission control for the deadline class.  The main
+   thread and a series of helper threads ask for deadline
+   reservations one after another, and each must be admitted if
+   and only if the total utilization of the deadline threads
+   would stay at most 1. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* A reservation asked for by a helper thread. */
+struct request 
+  {
+    int64_t runtime, period;    /* Reservation. */
+    bool admitted;              /* Result of thread_set_deadline(). */
+    struct semaphore asked;     /* Upped after the request. */
+    struct semaphore *release;  /* Downed after the request. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+static thread_func requester;
+static bool request (struct request *, int64_t runtime, int64_t period,
+                     struct semaphore *release, struct semaphore *done);
+
+void
+test_edf_admit (void) 
+{
+  struct request requests[5];
+  struct semaphore release, done;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&release, 0);
+  sema_init (&done, 0);
+
+  if (thread_set_deadline (11, 10) || thread_set_deadline (5, 0)
+      || thread_set_deadline (-1, 10))
+    fail ("invalid reservation admitted");
+  msg ("Invalid reservations rejected.");
+
+  if (!thread_set_deadline (3, 10))
+    fail ("main thread's 3/10 rejected");
+  msg ("Utilization 0.3 admitted.");
+  if (!request (&requests[0], 5, 10, &release, &done))
+    fail ("5/10 rejected at utilization 0.3");
+  msg ("Utilization 0.8 admitted.");
+  if (request (&requests[1], 3, 10, &release, &done))
+    fail ("3/10 admitted at utilization 0.8");
+  msg ("Utilization 1.1 rejected.");
+  if (!request (&requests[2], 2, 10, &release, &done))
+    fail ("2/10 rejected at utilization 0.8");
+  msg ("Utilization 1.0 admitted.");
+  if (request (&requests[3], 1, 100, &release, &done))
+    fail ("1/100 admitted at utilization 1.0");
+  msg ("Utilization 1.01 rejected.");
+
+  /* Leaving the class gives the utilization back. */
+  if (!thread_set_deadline (0, 0))
+    fail ("main thread could not leave the deadline class");
+  if (!request (&requests[4], 3, 10, &release, &done))
+    fail ("3/10 rejected after main thread left");
+  msg ("Utilization 1.0 admitted after main thread left.");
+
+  /* So does exiting. */
+  for (i = 0; i < 5; i++)
+    sema_up (&release);
+  for (i = 0; i < 5; i++)
+    sema_down (&done);
+  if (!thread_set_deadline (10, 10))
+    fail ("10/10 rejected after all other threads exited");
+  msg ("Utilization 1.0 admitted after all other threads exited.");
+  thread_set_deadline (0, 0);
+}
+
+/* Starts a thread that asks for a RUNTIME / PERIOD reservation
+   in *R and waits for RELEASE before exiting, and returns whether
+   it was admitted. */
+static bool
+request (struct request *r, int64_t runtime, int64_t period,
+         struct semaphore *release, struct semaphore *done) 
+{
+  char name[16];
+
+  r->runtime = runtime;
+  r->period = period;
+  r->release = release;
+  r->done = done;
+  sema_init (&r->asked, 0);
+  snprintf (name, sizeof name, "dl %lld/%lld", runtime, period);
+  thread_create (name, PRI_MAX, requester, r);
+  sema_down (&r->asked);
+  return r->admitted;
+}
+
+static void
+requester (void *r_) 
+{
+  struct request *r = r_;
+
+  r->admitted = thread_set_deadline (r->runtime, r->period);
+  sema_up (&r->asked);
+  sema_down (r->release);
+  sema_up (r->done);
+}
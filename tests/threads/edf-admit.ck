@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-admit) begin
+(edf-admit) Invalid reservations rejected.
+(edf-admit) Utilization 0.3 admitted.
+(edf-admit) Utilization 0.8 admitted.
+(edf-admit) Utilization 1.1 rejected.
+(edf-admit) Utilization 1.0 admitted.
+(edf-admit) Utilization 1.01 rejected.
+(edf-admit) Utilization 1.0 admitted after main thread left.
+(edf-admit) Utilization 1.0 admitted after all other threads exited.
+(edf-admit) end
+EOF
+pass;
@@ -0,0 +1,169 @@
+/* Starts two periodic deadline threads, one with a 2/10 and one
+   with a 3/15 reservation, whose jobs each need about a tick of
+   CPU time, and runs them against two CPU-bound threads at
+   PRI_MAX - 1 and a deadline thread with a 1/10 reservation that
+   never stops running.  Every job of the periodic threads must
+   finish before its deadline, and the overrunning thread must be
+   throttled to about its reservation. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define JOB_CNT 20
+#define HOG_CNT 2
+
+/* A periodic deadline thread. */
+struct periodic 
+  {
+    int64_t runtime, period;    /* Reservation. */
+    int misses;                 /* Jobs that finished late. */
+    int64_t worst;              /* Longest job, release to finish. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+/* The thread that overruns its reservation. */
+struct overrun 
+  {
+    int64_t ticks_seen;         /* Timer ticks it ran during. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+/* Set to stop the hogs and the overrunning thread. */
+static volatile bool stop;
+
+static thread_func periodic, overrun, hog;
+
+void
+test_edf_deadline (void) 
+{
+  struct periodic periodics[2] =
+    {{.runtime = 2, .period = 10}, {.runtime = 3, .period = 15}};
+  struct overrun over;
+  struct semaphore done;
+  int64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Outrank the hogs, so that we can stop them. */
+  thread_set_priority (PRI_MAX);
+
+  sema_init (&done, 0);
+  stop = false;
+  start = timer_ticks ();
+  for (i = 0; i < 2; i++) 
+    {
+      char name[16];
+      periodics[i].misses = 0;
+      periodics[i].worst = 0;
+      periodics[i].done = &done;
+      snprintf (name, sizeof name, "dl %lld/%lld",
+                periodics[i].runtime, periodics[i].period);
+      thread_create (name, PRI_MAX, periodic, &periodics[i]);
+    }
+  over.ticks_seen = 0;
+  over.done = &done;
+  thread_create ("dl 1/10", PRI_MAX, overrun, &over);
+  for (i = 0; i < HOG_CNT; i++)
+    thread_create ("hog", PRI_MAX - 1, hog, &done);
+
+  /* Wait for the periodic threads. */
+  sema_down (&done);
+  sema_down (&done);
+  elapsed = timer_ticks () - start;
+  stop = true;
+  for (i = 0; i < 1 + HOG_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < 2; i++) 
+    {
+      struct periodic *p = &periodics[i];
+      if (p->misses != 0)
+        fail ("%lld/%lld thread missed %d of %d deadlines, "
+              "worst job took %lld ticks",
+              p->runtime, p->period, p->misses, JOB_CNT, p->worst);
+      msg ("%lld/%lld thread met all %d deadlines.",
+           p->runtime, p->period, JOB_CNT);
+    }
+
+  /* The overrunning thread gets one tick per period, which it
+     may see the start and end of. */
+  if (over.ticks_seen == 0)
+    fail ("overrunning thread starved");
+  if (over.ticks_seen > (elapsed / 10 + 1) * 2)
+    fail ("overrunning thread ran during %lld of %lld ticks",
+          over.ticks_seen, elapsed);
+  msg ("Overrunning thread was throttled.");
+}
+
+static void
+periodic (void *p_) 
+{
+  struct periodic *p = p_;
+  int64_t base;
+  int i;
+
+  if (!thread_set_deadline (p->runtime, p->period))
+    fail ("%lld/%lld reservation rejected", p->runtime, p->period);
+  base = timer_ticks ();
+
+  for (i = 0; i < JOB_CNT; i++) 
+    {
+      int64_t release = base + i * p->period;
+      int64_t now = timer_ticks ();
+      int64_t took;
+
+      if (now < release)
+        timer_sleep (release - now);
+
+      /* Spin across one tick boundary. */
+      now = timer_ticks ();
+      while (timer_ticks () == now)
+        continue;
+
+      took = timer_ticks () - release;
+      if (took > p->worst)
+        p->worst = took;
+      if (took > p->period)
+        p->misses++;
+    }
+
+  thread_set_deadline (0, 0);
+  sema_up (p->done);
+}
+
+static void
+overrun (void *o_) 
+{
+  struct overrun *o = o_;
+  int64_t last = -1;
+
+  if (!thread_set_deadline (1, 10))
+    fail ("1/10 reservation rejected");
+
+  while (!stop) 
+    {
+      int64_t now = timer_ticks ();
+      if (now != last) 
+        {
+          o->ticks_seen++;
+          last = now;
+        }
+    }
+
+  thread_set_deadline (0, 0);
+  sema_up (o->done);
+}
+
+static void
+hog (void *done) 
+{
+  while (!stop)
+    continue;
+  sema_up (done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-deadline) begin
+(edf-deadline) 2/10 thread met all 20 deadlines.
+(edf-deadline) 3/15 thread met all 20 deadlines.
+(edf-deadline) Overrunning thread was throttled.
+(edf-deadline) end
+EOF
+pass;
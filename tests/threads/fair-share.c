@@ -0,0 +1,98 @@
+/* Runs with the -fair kernel option.  Starts three CPU-bound
+   threads at priorities PRI_DEFAULT + 7, PRI_DEFAULT and
+   PRI_DEFAULT - 11, lets them compete for the CPU while the main
+   thread sleeps, and checks that each gets CPU time roughly in
+   proportion to its weight: about 1.95 times as much for the
+   first as for the second, and about 2.85 times as much for the
+   second as for the third.  Under strict priority scheduling, the
+   first thread would get all of it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 3
+
+/* Priority of each thread. */
+static const int priorities[THREAD_CNT] =
+  {PRI_DEFAULT + 7, PRI_DEFAULT, PRI_DEFAULT - 11};
+
+/* Result of each thread. */
+struct spinner 
+  {
+    long long iterations;       /* Loop iterations completed. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+/* Set to stop the spinners. */
+static volatile bool stop;
+
+static thread_func spinner;
+static void check_ratio (const struct spinner *, int a, int b,
+                         int min_tenths, int max_tenths);
+
+void
+test_fair_share (void) 
+{
+  struct spinner spinners[THREAD_CNT];
+  struct semaphore done;
+  int i;
+
+  ASSERT (thread_fair);
+
+  /* Outrank the spinners, so that we get to run as soon as we
+     wake up and can stop them all at the same moment. */
+  thread_set_priority (PRI_MAX);
+
+  sema_init (&done, 0);
+  stop = false;
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      spinners[i].iterations = 0;
+      spinners[i].done = &done;
+      snprintf (name, sizeof name, "priority %d", priorities[i]);
+      thread_create (name, priorities[i], spinner, &spinners[i]);
+    }
+
+  timer_sleep (300);
+  stop = true;
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (spinners[i].iterations == 0)
+      fail ("thread at priority %d starved", priorities[i]);
+  msg ("No thread starved.");
+
+  check_ratio (spinners, 0, 1, 14, 26);
+  check_ratio (spinners, 1, 2, 20, 40);
+}
+
+/* Checks that spinner A ran between MIN_TENTHS / 10 and
+   MAX_TENTHS / 10 times as much as spinner B. */
+static void
+check_ratio (const struct spinner *spinners, int a, int b,
+             int min_tenths, int max_tenths) 
+{
+  long long ratio = spinners[a].iterations * 10 / spinners[b].iterations;
+
+  if (ratio < min_tenths || ratio > max_tenths)
+    fail ("priority %d got %lld.%lld times the CPU time of priority %d",
+          priorities[a], ratio / 10, ratio % 10, priorities[b]);
+  msg ("Priority %d got its share relative to priority %d.",
+       priorities[a], priorities[b]);
+}
+
+static void
+spinner (void *s_) 
+{
+  struct spinner *s = s_;
+
+  while (!stop)
+    s->iterations++;
+  sema_up (s->done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fair-share) begin
+(fair-share) No thread starved.
+(fair-share) Priority 38 got its share relative to priority 31.
+(fair-share) Priority 31 got its share relative to priority 20.
+(fair-share) end
+EOF
+pass;
@@ -0,0 +1,136 @@
+/* Checks the buddy allocator in the user pool, which nothing
+   else uses in this kernel.  A request that is not a power of 2
+   must give back the tail of its block, freeing blocks in any
+   order must merge them back into the blocks they came from, and
+   a request with no free block of its own order must split a
+   bigger one.  Only multi-page requests are made, so the
+   per-CPU magazines stay out of the way. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
+
+static void wait_until_quiet (size_t cnt[PALLOC_ORDERS]);
+static size_t free_pages (const size_t cnt[PALLOC_ORDERS]);
+static bool same_blocks (const size_t a[PALLOC_ORDERS],
+                         const size_t b[PALLOC_ORDERS]);
+
+void
+test_palloc_buddy (void) 
+{
+  size_t before[PALLOC_ORDERS], now[PALLOC_ORDERS];
+  void *a, *b, *c, *d, *big;
+  void **held;
+  size_t held_cnt, i;
+  int top;
+
+  wait_until_quiet (before);
+  for (top = PALLOC_ORDERS - 1; top > 0 && before[top] == 0; top--)
+    continue;
+  if (top < 2)
+    fail ("user pool has no free block of 4 pages or more");
+
+  /* 3 and 5 pages come from blocks of 4 and 8. */
+  a = palloc_get_multiple (PAL_USER, 3);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (a == NULL || free_pages (now) != free_pages (before) - 3)
+    fail ("3-page allocation did not give back its tail");
+  b = palloc_get_multiple (PAL_USER, 5);
+  c = palloc_get_multiple (PAL_USER, 3);
+  d = palloc_get_multiple (PAL_USER, 5);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (b == NULL || c == NULL || d == NULL
+      || free_pages (now) != free_pages (before) - 16)
+    fail ("5-page allocations did not give back their tails");
+  msg ("Allocations gave back their tails.");
+
+  palloc_free_multiple (b, 5);
+  palloc_free_multiple (c, 3);
+  palloc_free_multiple (a, 3);
+  palloc_free_multiple (d, 5);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (!same_blocks (before, now))
+    fail ("freed blocks did not merge back");
+  msg ("Freed blocks merged back.");
+
+  big = palloc_get_multiple (PAL_USER, (size_t) 1 << top);
+  if (big == NULL)
+    fail ("could not allocate the largest free block again");
+  palloc_free_multiple (big, (size_t) 1 << top);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (!same_blocks (before, now))
+    fail ("largest block did not merge back");
+  msg ("Largest block allocated again.");
+
+  /* Use up the 2-page blocks, so that the next 2-page request
+     has to split a bigger block and leave one 2-page half free. */
+  held = malloc ((before[1] + 1) * sizeof *held);
+  ASSERT (held != NULL);
+  for (held_cnt = 0; held_cnt < before[1]; held_cnt++) 
+    {
+      held[held_cnt] = palloc_get_multiple (PAL_USER, 2);
+      ASSERT (held[held_cnt] != NULL);
+    }
+  palloc_get_free_blocks (PAL_USER, now);
+  if (now[1] != 0)
+    fail ("%zu 2-page blocks left after taking them all", now[1]);
+  held[held_cnt] = palloc_get_multiple (PAL_USER, 2);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (held[held_cnt] == NULL || now[1] != 1)
+    fail ("2-page allocation did not split a bigger block");
+  held_cnt++;
+  msg ("Bigger block split.");
+
+  for (i = 0; i < held_cnt; i++)
+    palloc_free_multiple (held[i], 2);
+  free (held);
+  palloc_get_free_blocks (PAL_USER, now);
+  if (!same_blocks (before, now))
+    fail ("split blocks did not merge back");
+  msg ("Split blocks merged back.");
+}
+
+/* Idle CPUs take single pages from the user pool to zero them
+   until they have enough.  Waits until they are done, then
+   stores the user pool's free blocks in CNT. */
+static void
+wait_until_quiet (size_t cnt[PALLOC_ORDERS]) 
+{
+  size_t last[PALLOC_ORDERS];
+  int i;
+
+  palloc_get_free_blocks (PAL_USER, last);
+  for (i = 0; i < 100; i++) 
+    {
+      timer_sleep (5);
+      palloc_get_free_blocks (PAL_USER, cnt);
+      if (same_blocks (last, cnt))
+        return;
+      memcpy (last, cnt, sizeof last);
+    }
+  fail ("user pool never stopped changing");
+}
+
+/* Returns the number of pages in the free blocks counted by
+   CNT. */
+static size_t
+free_pages (const size_t cnt[PALLOC_ORDERS]) 
+{
+  size_t pages = 0;
+  int order;
+
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    pages += cnt[order] << order;
+  return pages;
+}
+
+/* Returns true if A and B count the same free blocks. */
+static bool
+same_blocks (const size_t a[PALLOC_ORDERS], const size_t b[PALLOC_ORDERS]) 
+{
+  return !memcmp (a, b, PALLOC_ORDERS * sizeof *a);
+}
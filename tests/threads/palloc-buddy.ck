@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Allocations gave back their tails.
+(palloc-buddy) Freed blocks merged back.
+(palloc-buddy) Largest block allocated again.
+(palloc-buddy) Bigger block split.
+(palloc-buddy) Split blocks merged back.
+(palloc-buddy) end
+EOF
+pass;
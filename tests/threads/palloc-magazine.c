@@ -0,0 +1,106 @@
+/* Checks the per-CPU page magazines of the user pool, which
+   nothing else uses in this kernel.  Taking more single pages
+   than a magazine holds must refill it from the pool and then
+   hand out pages from it, giving back more than it holds must
+   drain it, and every page must come back unharmed: no page is
+   handed out twice, and a freed page is handed out again. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+
+#define PAGE_CNT (MAGAZINE_MAX * 2)
+
+/* The user pool's magazine counters, added up over all CPUs. */
+struct counts 
+  {
+    long long hits, refills, misses, drains;
+  };
+
+static void get_counts (struct counts *);
+
+void
+test_palloc_magazine (void) 
+{
+  static uint8_t *pages[PAGE_CNT];
+  struct counts before, after;
+  uint8_t *page;
+  int i, j;
+
+  get_counts (&before);
+  for (i = 0; i < PAGE_CNT; i++) 
+    {
+      pages[i] = palloc_get_page (PAL_USER);
+      if (pages[i] == NULL)
+        fail ("could not get page %d", i);
+      memset (pages[i], i, PGSIZE);
+    }
+  get_counts (&after);
+  if (after.misses != before.misses)
+    fail ("magazine ran out of pages");
+  if (after.hits - before.hits + after.refills - before.refills != PAGE_CNT)
+    fail ("%lld hits and %lld refills for %d pages",
+          after.hits - before.hits, after.refills - before.refills,
+          PAGE_CNT);
+  if (after.refills - before.refills
+      < (PAGE_CNT - MAGAZINE_MAX) / MAGAZINE_BATCH)
+    fail ("only %lld refills for %d pages",
+          after.refills - before.refills, PAGE_CNT);
+  if (after.hits == before.hits)
+    fail ("no page came from a refilled magazine");
+  msg ("Magazine was refilled and hit.");
+
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = 0; j < PGSIZE; j++)
+      if (pages[i][j] != (uint8_t) i)
+        fail ("page %d byte %d is %#x, expected %#x",
+              i, j, pages[i][j], i);
+  msg ("Pages were all distinct.");
+
+  /* The magazine holds MAGAZINE_MAX pages, and each drain makes
+     room for MAGAZINE_BATCH more. */
+  get_counts (&before);
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+  get_counts (&after);
+  if (after.drains - before.drains
+      < (PAGE_CNT - MAGAZINE_MAX) / MAGAZINE_BATCH)
+    fail ("only %lld drains for %d pages",
+          after.drains - before.drains, PAGE_CNT);
+  msg ("Magazine was drained.");
+
+  /* The magazine hands back the page freed last. */
+  before = after;
+  page = palloc_get_page (PAL_USER);
+  get_counts (&after);
+  if (after.hits != before.hits + 1 || after.refills != before.refills)
+    fail ("page did not come from the magazine");
+  if (page != pages[PAGE_CNT - 1])
+    fail ("got %p back instead of the page freed last, %p",
+          page, pages[PAGE_CNT - 1]);
+  memset (page, 0x5a, PGSIZE);
+  palloc_free_page (page);
+  msg ("Freed page came back.");
+}
+
+/* Adds up the user pool's magazine counters over all CPUs into
+   *C. */
+static void
+get_counts (struct counts *c) 
+{
+  int i;
+
+  memset (c, 0, sizeof *c);
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      struct page_magazine *m = &cpus[i].magazines[1];
+
+      c->hits += m->hits;
+      c->refills += m->refills;
+      c->misses += m->misses;
+      c->drains += m->drains;
+    }
+}
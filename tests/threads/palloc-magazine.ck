@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-magazine) begin
+(palloc-magazine) Magazine was refilled and hit.
+(palloc-magazine) Pages were all distinct.
+(palloc-magazine) Magazine was drained.
+(palloc-magazine) Freed page came back.
+(palloc-magazine) end
+EOF
+pass;
@@ -0,0 +1,97 @@
+/* Checks that idle CPUs zero free pages of the user pool, which
+   nothing else uses in this kernel, ahead of PAL_ZERO requests.
+   Every free page is dirtied first, so a pre-zeroed page that is
+   not all zeros cannot have been zeroed by anyone but the idle
+   loop getting it wrong. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+static void wait_until_zeroed (struct palloc_zero_stats *);
+
+void
+test_palloc_zero_idle (void) 
+{
+  struct palloc_zero_stats before, now;
+  void *dirty = NULL, *page;
+  size_t dirty_cnt = 0, zero_cnt, i, j;
+
+  /* Take every free page, including the pre-zeroed ones, which
+     come back to the pool once it runs dry, fill each with a
+     pattern, and chain them through their first word. */
+  while ((page = palloc_get_page (PAL_USER)) != NULL) 
+    {
+      memset (page, 0xa5, PGSIZE);
+      *(void **) page = dirty;
+      dirty = page;
+      dirty_cnt++;
+    }
+  palloc_get_zero_stats (PAL_USER, &before);
+  if (before.ready != 0)
+    fail ("%zu pre-zeroed pages left with the pool empty", before.ready);
+  while (dirty != NULL) 
+    {
+      page = dirty;
+      dirty = *(void **) page;
+      palloc_free_page (page);
+    }
+  msg ("Dirtied every free page.");
+
+  wait_until_zeroed (&now);
+  if (now.idle_zeroed <= before.idle_zeroed || now.ready == 0)
+    fail ("idle CPUs zeroed no pages");
+  msg ("Idle CPUs zeroed pages.");
+
+  /* Nothing runs the idle loop until this thread blocks, so every
+     one of these is pre-zeroed. */
+  before = now;
+  zero_cnt = now.ready;
+  for (i = 0; i < zero_cnt; i++) 
+    {
+      uint8_t *p = palloc_get_page (PAL_USER | PAL_ZERO);
+
+      if (p == NULL)
+        fail ("could not get pre-zeroed page %zu", i);
+      for (j = 0; j < PGSIZE; j++)
+        if (p[j] != 0)
+          fail ("pre-zeroed page %zu byte %zu is %#x", i, j, p[j]);
+      *(void **) p = dirty;
+      dirty = p;
+    }
+  palloc_get_zero_stats (PAL_USER, &now);
+  if (now.hits - before.hits != (long long) zero_cnt)
+    fail ("%lld of %zu PAL_ZERO pages were pre-zeroed",
+          now.hits - before.hits, zero_cnt);
+  while (dirty != NULL) 
+    {
+      page = dirty;
+      dirty = *(void **) page;
+      palloc_free_page (page);
+    }
+  msg ("Pre-zeroed pages were all zeros.");
+}
+
+/* Sleeps until idle CPUs stop zeroing pages of the user pool,
+   then stores how its pre-zeroed pages are doing in *STATS. */
+static void
+wait_until_zeroed (struct palloc_zero_stats *stats) 
+{
+  struct palloc_zero_stats last;
+  int i;
+
+  palloc_get_zero_stats (PAL_USER, &last);
+  for (i = 0; i < 100; i++) 
+    {
+      timer_sleep (5);
+      palloc_get_zero_stats (PAL_USER, stats);
+      if (stats->ready > 0 && stats->idle_zeroed == last.idle_zeroed)
+        return;
+      last = *stats;
+    }
+  fail ("idle CPUs never stopped zeroing pages");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero-idle) begin
+(palloc-zero-idle) Dirtied every free page.
+(palloc-zero-idle) Idle CPUs zeroed pages.
+(palloc-zero-idle) Pre-zeroed pages were all zeros.
+(palloc-zero-idle) end
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Checks priority donation to every reader of a reader-writer
+   lock.  The main thread and thread R hold a reader-writer lock
+   shared, and R then blocks on a semaphore.  High priority
+   thread W blocks acquiring the lock exclusive, which must
+   donate W's priority to both readers.  When both readers have
+   released the lock, W gets it and the readers' priorities drop
+   back. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_and_sema 
+  {
+    struct rwlock rw;
+    struct semaphore sema;
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock_and_sema rs;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rs.rw);
+  sema_init (&rs.sema, 0);
+  rwlock_acquire_shared (&rs.rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rs);
+  thread_create ("writer", PRI_DEFAULT + 5, writer_thread_func, &rs);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  sema_up (&rs.sema);
+  rwlock_release_shared (&rs.rw);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_thread_func (void *rs_) 
+{
+  struct rwlock_and_sema *rs = rs_;
+
+  rwlock_acquire_shared (&rs->rw);
+  msg ("Reader acquired the lock.");
+  sema_down (&rs->sema);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  rwlock_release_shared (&rs->rw);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rs_) 
+{
+  struct rwlock_and_sema *rs = rs_;
+
+  rwlock_acquire_exclusive (&rs->rw);
+  msg ("Writer acquired the lock.");
+  rwlock_release_exclusive (&rs->rw);
+  msg ("Writer finished.");
+}
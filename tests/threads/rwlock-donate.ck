@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) Reader acquired the lock.
+(rwlock-donate) Main thread should have priority 36.  Actual priority: 36.
+(rwlock-donate) Reader should have priority 36.  Actual priority: 36.
+(rwlock-donate) Writer acquired the lock.
+(rwlock-donate) Writer finished.
+(rwlock-donate) Reader should have priority 32.  Actual priority: 32.
+(rwlock-donate) Main thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Checks that reader-writer locks prefer writers.  The main
+   thread holds a reader-writer lock shared while a writer and
+   then a higher-priority reader ask for it.  The reader must not
+   join the main thread as a second reader while the writer is
+   waiting, so the writer gets the lock first. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_shared (&rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rw);
+  msg ("Main thread releasing the lock.");
+  rwlock_release_shared (&rw);
+  msg ("Main thread finished.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_exclusive (rw);
+  msg ("Writer acquired the lock.");
+  rwlock_release_exclusive (rw);
+  msg ("Writer finished.");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_shared (rw);
+  msg ("Reader acquired the lock.");
+  rwlock_release_shared (rw);
+  msg ("Reader finished.");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer) begin
+(rwlock-writer) Main thread releasing the lock.
+(rwlock-writer) Writer acquired the lock.
+(rwlock-writer) Reader acquired the lock.
+(rwlock-writer) Reader finished.
+(rwlock-writer) Writer finished.
+(rwlock-writer) Main thread finished.
+(rwlock-writer) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Makes control ping-pong between two threads of equal priority
+   through a pair of semaphores, so that every sema_down() blocks
+   and switches to the other thread, and reports how fast thread
+   switches are.  The numbers are for comparison between context
+   switch implementations; they are not checked. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define ROUND_TRIPS 20000
+
+static struct semaphore ping, pong, done;
+
+static thread_func ponger;
+
+void
+test_sema_pingpong (void) 
+{
+  uint64_t start_cycles, cycles;
+  int64_t start_ticks, ticks;
+  long long switches = 2LL * ROUND_TRIPS;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  sema_init (&done, 0);
+  thread_create ("ponger", PRI_DEFAULT, ponger, NULL);
+
+  msg ("Ping-ponging %d times.", ROUND_TRIPS);
+  start_ticks = timer_ticks ();
+  start_cycles = rdtsc ();
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  cycles = rdtsc () - start_cycles;
+  ticks = timer_elapsed (start_ticks);
+  sema_down (&done);
+
+  msg ("Done, %lld thread switches.", switches);
+  msg ("%"PRIu64" cycles per switch, %lld switches per second.",
+       cycles / switches,
+       ticks > 0 ? switches * TIMER_FREQ / ticks : switches * TIMER_FREQ);
+}
+
+static void
+ponger (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ROUND_TRIPS; i++) 
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+  sema_up (&done);
+}
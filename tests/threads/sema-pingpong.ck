@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "missing begin message\n"
+  if !grep (/^\(sema-pingpong\) begin$/, @output);
+fail "missing end message\n"
+  if !grep (/^\(sema-pingpong\) end$/, @output);
+fail "ping-pong did not complete\n"
+  if !grep (/^\(sema-pingpong\) Done, 40000 thread switches\.$/, @output);
+fail "missing switch statistics\n"
+  if !grep (/^\(sema-pingpong\) \d+ cycles per switch, \d+ switches per second\.$/,
+	    @output);
+pass;
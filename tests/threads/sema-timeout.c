@@ -0,0 +1,87 @@
+/* Checks sema_down_timeout().  Downing a semaphore nobody ups
+   must give up after the timeout, an up before the timeout must
+   succeed, and a waiter that timed out must leave the wait
+   queue, so that the next up goes to the waiters still there, in
+   the order they arrived. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static thread_func upper_thread_func;
+static thread_func quitter_thread_func;
+static thread_func waiter_thread_func;
+
+void
+test_sema_timeout (void) 
+{
+  struct semaphore sema;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&sema, 0);
+  start = timer_ticks ();
+  if (sema_down_timeout (&sema, 10))
+    fail ("sema_down_timeout() succeeded with nobody upping");
+  if (timer_elapsed (start) < 10)
+    fail ("sema_down_timeout() gave up after %"PRId64" ticks",
+          timer_elapsed (start));
+  msg ("Timed out.");
+
+  thread_create ("upper", PRI_DEFAULT + 1, upper_thread_func, &sema);
+  if (!sema_down_timeout (&sema, 1000))
+    fail ("sema_down_timeout() timed out despite an up");
+  msg ("Downed before the timeout.");
+
+  thread_create ("quitter", PRI_DEFAULT + 2, quitter_thread_func, &sema);
+  for (i = 0; i < 3; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT + 1, waiter_thread_func, &sema);
+    }
+  timer_sleep (20);
+  msg ("Upping the semaphore 3 times.");
+  for (i = 0; i < 3; i++)
+    sema_up (&sema);
+  msg ("Main thread finished.");
+}
+
+static void
+upper_thread_func (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+
+  timer_sleep (5);
+  msg ("Upping the semaphore.");
+  sema_up (sema);
+}
+
+static void
+quitter_thread_func (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+
+  if (sema_down_timeout (sema, 10))
+    fail ("quitter downed the semaphore");
+  msg ("Quitter timed out.");
+}
+
+static void
+waiter_thread_func (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+
+  sema_down (sema);
+  msg ("Thread %s woke up.", thread_name ());
+}
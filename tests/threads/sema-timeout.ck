@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sema-timeout) begin
+(sema-timeout) Timed out.
+(sema-timeout) Upping the semaphore.
+(sema-timeout) Downed before the timeout.
+(sema-timeout) Quitter timed out.
+(sema-timeout) Upping the semaphore 3 times.
+(sema-timeout) Thread waiter 0 woke up.
+(sema-timeout) Thread waiter 1 woke up.
+(sema-timeout) Thread waiter 2 woke up.
+(sema-timeout) Main thread finished.
+(sema-timeout) end
+EOF
+pass;
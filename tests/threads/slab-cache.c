@@ -0,0 +1,132 @@
+/* Checks an object cache with an odd object size, a bigger
+   than default alignment, and a constructor.  Enough objects are
+   allocated and freed that the per-CPU magazine has to be
+   refilled from slabs and drained back into them many times.
+   The constructor must only run when a slab is created, objects
+   must be aligned and come back in their constructed state,
+   free() must hand them back to their cache, and the empty slabs
+   left over must go back to the page allocator. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 200
+#define OBJ_ALIGN 64
+#define OBJ_MAGIC 0x0b1ec7
+
+/* 100 bytes, which the cache rounds up to 128. */
+struct obj 
+  {
+    unsigned magic;             /* OBJ_MAGIC once constructed. */
+    int id;                     /* -1 while not allocated. */
+    char pad[92];
+  };
+
+static int ctor_cnt;
+
+static void
+obj_ctor (void *p) 
+{
+  struct obj *o = p;
+
+  o->magic = OBJ_MAGIC;
+  o->id = -1;
+  ctor_cnt++;
+}
+
+static void check_ctor_cnt (struct kmem_cache *);
+
+void
+test_slab_cache (void) 
+{
+  static struct obj *objs[OBJ_CNT];
+  struct kmem_cache *c;
+  struct kmem_stats stats;
+  size_t peak_slabs;
+  int i;
+
+  c = kmem_cache_create ("slab-cache", sizeof (struct obj), OBJ_ALIGN,
+                         obj_ctor);
+  ASSERT (c != NULL);
+  if (kmem_cache_size (c) != 128)
+    fail ("object size %zu, expected 128", kmem_cache_size (c));
+
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      struct obj *o = objs[i] = kmem_cache_alloc (c);
+
+      if (o == NULL)
+        fail ("allocation %d failed", i);
+      if ((uintptr_t) o % OBJ_ALIGN != 0)
+        fail ("object %p is not aligned on %d bytes", o, OBJ_ALIGN);
+      if (kmem_cache_of (o) != c)
+        fail ("object %p does not belong to its cache", o);
+      if (o->magic != OBJ_MAGIC || o->id != -1)
+        fail ("object %p is not in its constructed state", o);
+      o->id = i;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    if (objs[i]->id != i)
+      fail ("object %d was handed out twice", i);
+  check_ctor_cnt (c);
+  kmem_cache_get_stats (c, &stats);
+  if (stats.created_cnt < 2)
+    fail ("%d objects fit in %zu slab", OBJ_CNT, stats.created_cnt);
+  peak_slabs = stats.slab_cnt;
+  msg ("Objects are aligned and constructed once per slab.");
+
+  /* Free the even objects directly and the odd ones through
+     free(), in the order they were allocated. */
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      objs[i]->id = -1;
+      if (i % 2 == 0)
+        kmem_cache_free (c, objs[i]);
+      else
+        free (objs[i]);
+    }
+  kmem_cache_get_stats (c, &stats);
+  if (stats.in_use != 0)
+    fail ("%zu objects still in use after freeing them all", stats.in_use);
+  msg ("free() returned objects to their cache.");
+
+  /* Each slab left either holds an object cached in a magazine
+     or is the one empty slab the cache keeps. */
+  if (stats.slab_cnt >= peak_slabs || stats.slab_cnt > stats.cached + 1)
+    fail ("%zu of %zu slabs kept with %zu objects cached",
+          stats.slab_cnt, peak_slabs, stats.cached);
+  msg ("Empty slabs went back to the page allocator.");
+
+  /* Objects come back constructed without running the
+     constructor again. */
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      struct obj *o = objs[i] = kmem_cache_alloc (c);
+
+      if (o == NULL)
+        fail ("reallocation %d failed", i);
+      if (o->magic != OBJ_MAGIC || o->id != -1)
+        fail ("reused object %p is not in its constructed state", o);
+    }
+  check_ctor_cnt (c);
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (c, objs[i]);
+  msg ("Reused objects kept their constructed state.");
+}
+
+/* Fails unless the constructor ran once for each object of each
+   slab C ever created. */
+static void
+check_ctor_cnt (struct kmem_cache *c) 
+{
+  struct kmem_stats stats;
+
+  kmem_cache_get_stats (c, &stats);
+  if ((size_t) ctor_cnt != stats.obj_cnt * stats.created_cnt)
+    fail ("constructor ran %d times for %zu slabs of %zu objects",
+          ctor_cnt, stats.created_cnt, stats.obj_cnt);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Objects are aligned and constructed once per slab.
+(slab-cache) free() returned objects to their cache.
+(slab-cache) Empty slabs went back to the page allocator.
+(slab-cache) Reused objects kept their constructed state.
+(slab-cache) end
+EOF
+pass;
@@ -0,0 +1,114 @@
+/* Runs with 4 CPUs.  Starts twice as many CPU-bound threads as
+   there are CPUs, all on the creator's CPU, and checks that the
+   other CPUs take some of them over while the creator sleeps.
+   Nothing but idle stealing and the balancer moves a thread
+   between run queues, so without them every spinner would run on
+   the one CPU it started on. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+
+/* Result of each thread. */
+struct spinner 
+  {
+    long long iterations;       /* Loop iterations completed. */
+    unsigned cpu_mask;          /* Bit N set if it ran on CPU N. */
+    struct semaphore *done;     /* Upped when finished. */
+  };
+
+/* Set to stop the spinners. */
+static volatile bool stop;
+
+static thread_func spinner;
+static long long migration_cnt (void);
+
+void
+test_smp_balance (void) 
+{
+  struct spinner spinners[THREAD_CNT];
+  struct semaphore done;
+  struct cpu *home;
+  enum intr_level old_level;
+  long long migrations;
+  unsigned cpu_mask = 0;
+  int i;
+
+  if (cpu_cnt < 2)
+    fail ("needs more than one CPU, but only %d is online", cpu_cnt);
+
+  sema_init (&done, 0);
+  stop = false;
+  migrations = migration_cnt ();
+
+  old_level = intr_disable ();
+  home = this_cpu ();
+  intr_set_level (old_level);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      spinners[i].iterations = 0;
+      spinners[i].cpu_mask = 0;
+      spinners[i].done = &done;
+      snprintf (name, sizeof name, "spinner %d", i);
+      thread_create_on (home, name, PRI_DEFAULT, spinner, &spinners[i]);
+    }
+
+  /* Long enough for every spinner to get a time slice even if
+     they all stayed on one CPU. */
+  timer_sleep (THREAD_CNT * 8);
+  stop = true;
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      if (spinners[i].iterations == 0)
+        fail ("thread %d never ran", i);
+      cpu_mask |= spinners[i].cpu_mask;
+    }
+  msg ("all %d threads ran.", THREAD_CNT);
+
+  if ((cpu_mask & (cpu_mask - 1)) == 0)
+    fail ("all threads ran on one CPU (mask %#x)", cpu_mask);
+  msg ("threads ran on more than one CPU.");
+
+  if (migration_cnt () <= migrations)
+    fail ("no thread was stolen or pulled to another CPU");
+  msg ("threads were moved between CPUs.");
+}
+
+/* Returns the number of threads moved between run queues so
+   far, over all CPUs. */
+static long long
+migration_cnt (void) 
+{
+  long long cnt = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += cpus[i].idle_steals + cpus[i].balance_pulls;
+  return cnt;
+}
+
+static void
+spinner (void *s_) 
+{
+  struct spinner *s = s_;
+
+  while (!stop)
+    {
+      enum intr_level old_level = intr_disable ();
+      s->cpu_mask |= 1u << this_cpu ()->id;
+      intr_set_level (old_level);
+      s->iterations++;
+    }
+  sema_up (s->done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(smp-balance) begin
+(smp-balance) all 8 threads ran.
+(smp-balance) threads ran on more than one CPU.
+(smp-balance) threads were moved between CPUs.
+(smp-balance) end
+EOF
+pass;
@@ -17,6 +17,21 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-scale", test_alarm_scale},
+    {"alarm-tickless", test_alarm_tickless},
+    {"smp-balance", test_smp_balance},
+    {"sema-pingpong", test_sema_pingpong},
+    {"fair-share", test_fair_share},
+    {"edf-admit", test_edf_admit},
+    {"edf-deadline", test_edf_deadline},
+    {"rwlock-writer", test_rwlock_writer},
+    {"rwlock-donate", test_rwlock_donate},
+    {"sema-timeout", test_sema_timeout},
+    {"palloc-buddy", test_palloc_buddy},
+    {"vmalloc-reuse", test_vmalloc_reuse},
+    {"slab-cache", test_slab_cache},
+    {"palloc-magazine", test_palloc_magazine},
+    {"palloc-zero-idle", test_palloc_zero_idle},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,6 +40,7 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-deep", test_priority_donate_deep},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
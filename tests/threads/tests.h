@@ -11,6 +11,21 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_scale;
+extern test_func test_alarm_tickless;
+extern test_func test_smp_balance;
+extern test_func test_sema_pingpong;
+extern test_func test_fair_share;
+extern test_func test_edf_admit;
+extern test_func test_edf_deadline;
+extern test_func test_rwlock_writer;
+extern test_func test_rwlock_donate;
+extern test_func test_sema_timeout;
+extern test_func test_palloc_buddy;
+extern test_func test_vmalloc_reuse;
+extern test_func test_slab_cache;
+extern test_func test_palloc_magazine;
+extern test_func test_palloc_zero_idle;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,6 +34,7 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_deep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
@@ -0,0 +1,250 @@
+/* Runs with 4 CPUs.  Checks the big-block path of malloc(),
+   which goes through vmalloc().
+
+   The main thread and some helpers keep a few big blocks each
+   alive at a time, through enough malloc/free cycles for freed
+   addresses to pile up past the point where vmalloc() shoots
+   down the TLBs and recycles them.  Every block must keep its
+   contents and report its size correctly, and an address the
+   main thread freed may only come back once every CPU has
+   flushed its TLB since.  Finally realloc() must copy correctly
+   between small blocks and big ones. */
+
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+#define HELPER_CNT 3            /* Threads besides the main one. */
+#define CYCLE_CNT 600           /* Blocks allocated by each thread. */
+#define LIVE_CNT 4              /* Blocks each thread keeps alive. */
+
+/* Sizes of the blocks, all too big for the malloc() caches. */
+static const size_t sizes[] = { 1500, 4096, 5000, 9000, 12288 };
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+/* A live block. */
+struct block 
+  {
+    uint8_t *p;                 /* Start of block, or null. */
+    size_t size;                /* Bytes asked for. */
+    uint8_t fill;               /* Byte it is filled with. */
+  };
+
+/* An address the main thread freed, and the TLB shootdown
+   generation every CPU had reached right after. */
+struct freed 
+  {
+    void *p;
+    uint64_t gen;
+  };
+
+/* Addresses the main thread freed, oldest first. */
+static struct freed freed_log[CYCLE_CNT];
+static size_t freed_cnt;
+
+static thread_func helper;
+static void run_cycles (int id, bool log);
+static void check_block (const struct block *);
+static void check_reuse (const void *p);
+static uint64_t min_tlb_gen (void);
+static void check_realloc (void);
+
+void
+test_vmalloc_reuse (void) 
+{
+  struct semaphore done;
+  uint64_t start_gen;
+  int i;
+
+  sema_init (&done, 0);
+  freed_cnt = 0;
+  start_gen = min_tlb_gen ();
+
+  for (i = 0; i < HELPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "helper %d", i);
+      thread_create (name, PRI_DEFAULT, helper, &done);
+    }
+  run_cycles (HELPER_CNT, true);
+  for (i = 0; i < HELPER_CNT; i++)
+    sema_down (&done);
+  msg ("All blocks kept their contents and sizes.");
+
+  if (min_tlb_gen () <= start_gen)
+    fail ("freed blocks were never shot down");
+  msg ("Freed addresses were reused only after a shootdown.");
+
+  check_realloc ();
+  msg ("realloc() copied between small and big blocks.");
+}
+
+static void
+helper (void *done_) 
+{
+  static int next_id;
+  struct semaphore *done = done_;
+
+  run_cycles (__atomic_fetch_add (&next_id, 1, __ATOMIC_SEQ_CST), false);
+  sema_up (done);
+}
+
+/* Allocates CYCLE_CNT big blocks, keeping up to LIVE_CNT of them
+   alive at once, and checks each one before freeing it.  If LOG,
+   checks that no address comes back before a shootdown. */
+static void
+run_cycles (int id, bool log) 
+{
+  struct block live[LIVE_CNT];
+  int i;
+
+  memset (live, 0, sizeof live);
+  for (i = 0; i < CYCLE_CNT; i++) 
+    {
+      struct block *b = &live[i % LIVE_CNT];
+
+      if (b->p != NULL) 
+        {
+          check_block (b);
+          free (b->p);
+          if (log) 
+            {
+              freed_log[freed_cnt].p = b->p;
+              freed_log[freed_cnt].gen = min_tlb_gen ();
+              freed_cnt++;
+            }
+        }
+
+      b->size = sizes[(i + id) % SIZE_CNT];
+      b->fill = id * 64 + i;
+      b->p = malloc (b->size);
+      if (b->p == NULL)
+        fail ("thread %d: malloc (%zu) failed", id, b->size);
+      if (!is_vmalloc_vaddr (b->p))
+        fail ("thread %d: %zu-byte block not from vmalloc()", id, b->size);
+      if (vmalloc_size (b->p) != ROUND_UP (b->size, PGSIZE))
+        fail ("thread %d: %zu-byte block has size %zu", id, b->size,
+              vmalloc_size (b->p));
+      if (log)
+        check_reuse (b->p);
+      memset (b->p, b->fill, b->size);
+    }
+
+  for (i = 0; i < LIVE_CNT; i++) 
+    {
+      check_block (&live[i]);
+      free (live[i].p);
+    }
+}
+
+/* Checks that B still holds its fill byte throughout. */
+static void
+check_block (const struct block *b) 
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < b->size; ofs++)
+    if (b->p[ofs] != b->fill)
+      fail ("block %p: byte %zu is %#x, not %#x",
+            b->p, ofs, b->p[ofs], b->fill);
+}
+
+/* Checks that P, just returned by malloc(), was not freed by the
+   main thread without every CPU flushing its TLB since. */
+static void
+check_reuse (const void *p) 
+{
+  size_t i;
+
+  for (i = freed_cnt; i-- > 0; )
+    if (freed_log[i].p == p) 
+      {
+        if (min_tlb_gen () <= freed_log[i].gen)
+          fail ("%p reused without a TLB shootdown", p);
+        return;
+      }
+}
+
+/* Returns the lowest TLB shootdown generation any CPU has
+   flushed up to. */
+static uint64_t
+min_tlb_gen (void) 
+{
+  uint64_t gen = UINT64_MAX;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      uint64_t g = __atomic_load_n (&cpus[i].tlb_gen, __ATOMIC_ACQUIRE);
+      if (g < gen)
+        gen = g;
+    }
+  return gen;
+}
+
+/* Fails unless the first SIZE bytes of P are SEED, SEED + 1, ...
+   modulo 256. */
+static void
+check_bytes (const uint8_t *p, size_t size, uint8_t seed, const char *what) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (uint8_t) (seed + i))
+      fail ("%s: byte %zu is %#x", what, i, p[i]);
+}
+
+/* Fills the SIZE bytes at P with SEED, SEED + 1, ... modulo
+   256. */
+static void
+fill_bytes (uint8_t *p, size_t size, uint8_t seed) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = seed + i;
+}
+
+/* Moves a block from a malloc() cache to vmalloc() and back,
+   and between vmalloc() blocks of different sizes. */
+static void
+check_realloc (void) 
+{
+  uint8_t *p;
+
+  p = malloc (100);
+  ASSERT (p != NULL && !is_vmalloc_vaddr (p));
+  fill_bytes (p, 100, 1);
+
+  p = realloc (p, 5000);
+  if (p == NULL || !is_vmalloc_vaddr (p))
+    fail ("realloc to 5000 bytes did not give a big block");
+  check_bytes (p, 100, 1, "small to big");
+  fill_bytes (p, 5000, 2);
+
+  p = realloc (p, 3 * PGSIZE);
+  if (p == NULL || vmalloc_size (p) != 3 * PGSIZE)
+    fail ("realloc to 3 pages failed");
+  check_bytes (p, 5000, 2, "big to bigger");
+  fill_bytes (p, 3 * PGSIZE, 3);
+
+  p = realloc (p, 2 * PGSIZE);
+  if (p == NULL || vmalloc_size (p) != 2 * PGSIZE)
+    fail ("realloc to 2 pages failed");
+  check_bytes (p, 2 * PGSIZE, 3, "big to smaller");
+
+  p = realloc (p, 200);
+  if (p == NULL || is_vmalloc_vaddr (p))
+    fail ("realloc to 200 bytes did not give a small block");
+  check_bytes (p, 200, 3, "big to small");
+  free (p);
+}
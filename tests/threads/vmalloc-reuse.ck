@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vmalloc-reuse) begin
+(vmalloc-reuse) All blocks kept their contents and sizes.
+(vmalloc-reuse) Freed addresses were reused only after a shootdown.
+(vmalloc-reuse) realloc() copied between small and big blocks.
+(vmalloc-reuse) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Checks that a forked child inherits the FPU state that the
+   parent has in its registers at the time of the fork, not an
+   older saved copy.  The parent puts a new value in %xmm0 right
+   before each fork, without being switched out in between, and
+   each child reports whether it got that value.  Runs with 4
+   CPUs, so that children start on other CPUs while the parent
+   is still in fork(). */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FORK_CNT 10
+
+static void
+set_xmm0 (uint64_t value) 
+{
+  asm volatile ("movq %0, %%xmm0" : : "r" (value));
+}
+
+static uint64_t
+get_xmm0 (void) 
+{
+  uint64_t value;
+  asm volatile ("movq %%xmm0, %0" : "=r" (value));
+  return value;
+}
+
+void
+test_main (void) 
+{
+  int i;
+
+  for (i = 0; i < FORK_CNT; i++) 
+    {
+      uint64_t value = 0x0101010101010101ULL * (i + 1);
+      int pid;
+
+      set_xmm0 (value);
+      pid = fork ("child");
+      if (pid == 0)
+        exit (get_xmm0 () == value ? 0 : 1);
+      if (get_xmm0 () != value)
+        fail ("parent lost its FPU state in fork %d", i);
+      if (wait (pid) != 0)
+        fail ("child %d did not inherit parent's FPU state", i);
+    }
+  msg ("%d children inherited parent's FPU state", FORK_CNT);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-fpu) begin
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+child: exit(0)
+(fork-fpu) 10 children inherited parent's FPU state
+(fork-fpu) end
+fork-fpu: exit(0)
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Checks that SSE registers survive context switches and are
+   inherited by fork().  The parent puts a value in %xmm0 and
+   forks; the child checks that it got the same value, puts its
+   own value in %xmm0, and both processes spin for a while so
+   that they are switched back and forth, and then check that
+   %xmm0 still holds their own value. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PARENT_VALUE 0x1111111111111111ULL
+#define CHILD_VALUE 0x2222222222222222ULL
+#define SPIN_CNT 50000000
+
+static void
+set_xmm0 (uint64_t value) 
+{
+  asm volatile ("movq %0, %%xmm0" : : "r" (value));
+}
+
+static uint64_t
+get_xmm0 (void) 
+{
+  uint64_t value;
+  asm volatile ("movq %%xmm0, %0" : "=r" (value));
+  return value;
+}
+
+/* Spins, checking every so often that %xmm0 holds EXPECTED. */
+static void
+spin (uint64_t expected, const char *who) 
+{
+  volatile int i;
+
+  for (i = 0; i < SPIN_CNT; i++)
+    if (i % 100000 == 0 && get_xmm0 () != expected)
+      fail ("%s lost its FPU state", who);
+  if (get_xmm0 () != expected)
+    fail ("%s lost its FPU state", who);
+}
+
+void
+test_main (void) 
+{
+  int pid;
+
+  set_xmm0 (PARENT_VALUE);
+  if ((pid = fork ("child"))) 
+    {
+      spin (PARENT_VALUE, "parent");
+      wait (pid);
+      msg ("parent kept its FPU state");
+    }
+  else 
+    {
+      if (get_xmm0 () != PARENT_VALUE)
+        fail ("child did not inherit parent's FPU state");
+      msg ("child inherited parent's FPU state");
+      set_xmm0 (CHILD_VALUE);
+      spin (CHILD_VALUE, "child");
+      msg ("child kept its FPU state");
+      exit (0);
+    }
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-switch) begin
+(fpu-switch) child inherited parent's FPU state
+(fpu-switch) child kept its FPU state
+child: exit(0)
+(fpu-switch) parent kept its FPU state
+(fpu-switch) end
+fpu-switch: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Checks futex_wait() and futex_wake() as far as one thread
+   can, and the user-level mutex built on them, then reports how
+   long uncontended mutex operations take.  The time is for
+   comparison only; it is not checked. */
+
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LOCK_CNT 100000
+
+void
+test_main (void) 
+{
+  static struct mutex m = MUTEX_INITIALIZER;
+  int word = 1;
+  int64_t start, elapsed;
+  int i;
+
+  CHECK (futex_wait (&word, 0, -1) == -1, "futex_wait with wrong value");
+
+  start = uptime ();
+  CHECK (futex_wait (&word, 1, 30) == 1, "futex_wait times out");
+  elapsed = uptime () - start;
+  CHECK (elapsed >= 30, "slept at least 30 ms");
+
+  CHECK (futex_wake (&word, 1) == 0, "futex_wake with no waiters");
+
+  mutex_lock (&m);
+  CHECK (!mutex_trylock (&m), "mutex_trylock on locked mutex fails");
+  mutex_unlock (&m);
+  CHECK (mutex_trylock (&m), "mutex_trylock on unlocked mutex");
+  mutex_unlock (&m);
+
+  start = uptime ();
+  for (i = 0; i < LOCK_CNT; i++) 
+    {
+      mutex_lock (&m);
+      mutex_unlock (&m);
+    }
+  elapsed = uptime () - start;
+  msg ("%d lock/unlock pairs in %lld ms.", LOCK_CNT, elapsed);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@expected) = ("(futex) begin",
+		  "(futex) futex_wait with wrong value",
+		  "(futex) futex_wait times out",
+		  "(futex) slept at least 30 ms",
+		  "(futex) futex_wake with no waiters",
+		  "(futex) mutex_trylock on locked mutex fails",
+		  "(futex) mutex_trylock on unlocked mutex");
+for my $line (@expected) {
+    fail "missing \"$line\"\n" if !grep ($_ eq $line, @output);
+}
+fail "missing timing\n"
+  if !grep (/^\(futex\) 100000 lock\/unlock pairs in \d+ ms\.$/, @output);
+fail "missing end message\n"
+  if !grep (/^\(futex\) end$/, @output);
+pass;
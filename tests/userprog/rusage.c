@@ -0,0 +1,46 @@
+/* Checks getrusage().  The process spins in user mode and must
+   be charged user time for it.  A child that spins must show up
+   under RUSAGE_CHILDREN, but only once it has been waited for. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SPIN_CNT 20000000
+
+static void
+spin (void) 
+{
+  volatile int i;
+
+  for (i = 0; i < SPIN_CNT; i++)
+    continue;
+}
+
+void
+test_main (void) 
+{
+  struct rusage self, children;
+  int pid;
+
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0
+         && children.utime == 0 && children.stime == 0,
+         "getrusage(RUSAGE_CHILDREN) before wait");
+
+  spin ();
+  CHECK (getrusage (RUSAGE_SELF, &self) == 0
+         && self.utime > 0 && self.stime > 0,
+         "getrusage(RUSAGE_SELF)");
+
+  if ((pid = fork ("child")) == 0) 
+    {
+      spin ();
+      exit (0);
+    }
+  wait (pid);
+  CHECK (getrusage (RUSAGE_CHILDREN, &children) == 0
+         && children.utime > 0,
+         "getrusage(RUSAGE_CHILDREN) after wait");
+
+  CHECK (getrusage (42, &self) == -1, "getrusage(42) fails");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage) begin
+(rusage) getrusage(RUSAGE_CHILDREN) before wait
+(rusage) getrusage(RUSAGE_SELF)
+child: exit(0)
+(rusage) getrusage(RUSAGE_CHILDREN) after wait
+(rusage) getrusage(42) fails
+(rusage) end
+rusage: exit(0)
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Starts several threads in one process that add to a shared
+   counter under a futex-based mutex, joins them, and checks the
+   total and their exit statuses.  Also reports how long the
+   contended increments took; the time is not checked. */
+
+#include <mutex.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 20000
+
+static struct mutex counter_mutex = MUTEX_INITIALIZER;
+static int counter;
+static int gate;
+
+static int
+adder (void *aux) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      mutex_lock (&counter_mutex);
+      counter++;
+      mutex_unlock (&counter_mutex);
+    }
+  return (int) (intptr_t) aux;
+}
+
+static int
+waiter (void *aux UNUSED) 
+{
+  while (gate == 0)
+    futex_wait (&gate, 0, -1);
+  return 0;
+}
+
+void
+test_main (void) 
+{
+  tid_t tids[THREAD_CNT];
+  tid_t tid;
+  int64_t start;
+  int i;
+
+  start = uptime ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      tids[i] = thread_create (adder, (void *) (intptr_t) (i + 10));
+      CHECK (tids[i] != TID_ERROR, "create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == i + 10, "join thread %d", i);
+  msg ("%d increments in %lld ms.", THREAD_CNT * ITER_CNT, uptime () - start);
+  CHECK (counter == THREAD_CNT * ITER_CNT, "counter is %d",
+         THREAD_CNT * ITER_CNT);
+  CHECK (thread_join (tids[0]) == -1, "second join fails");
+
+  tid = thread_create (waiter, NULL);
+  CHECK (tid != TID_ERROR, "create waiter");
+  CHECK (wait (tid) == -1, "wait on a thread fails");
+  gate = 1;
+  futex_wake (&gate, 1);
+  CHECK (thread_join (tid) == 0, "join waiter");
+}
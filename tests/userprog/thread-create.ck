@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@expected) = ("(thread-create) begin",
+		  "(thread-create) create thread 0",
+		  "(thread-create) create thread 1",
+		  "(thread-create) create thread 2",
+		  "(thread-create) create thread 3",
+		  "(thread-create) join thread 0",
+		  "(thread-create) join thread 1",
+		  "(thread-create) join thread 2",
+		  "(thread-create) join thread 3",
+		  "(thread-create) counter is 80000",
+		  "(thread-create) second join fails",
+		  "(thread-create) create waiter",
+		  "(thread-create) wait on a thread fails",
+		  "(thread-create) join waiter",
+		  "(thread-create) end");
+for my $line (@expected) {
+    fail "missing \"$line\"\n" if !grep ($_ eq $line, @output);
+}
+fail "missing timing\n"
+  if !grep (/^\(thread-create\) 80000 increments in \d+ ms\.$/, @output);
+fail "expected exactly one exit message\n"
+  if grep (/^thread-create: exit\(/, @output) != 1;
+pass;
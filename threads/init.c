@@ -20,10 +20,15 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
@@ -84,8 +89,10 @@ main (void) {
 
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
+	kmem_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	vmalloc_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -100,11 +107,14 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+	fpu_init ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	smp_init ();
+	trace_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -233,6 +243,12 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-fair"))
+			thread_fair = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-trace"))
+			trace_enabled = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -242,6 +258,8 @@ parse_options (char **argv) {
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
+	if (thread_mlfqs && thread_fair)
+		PANIC ("-mlfqs and -fair are mutually exclusive");
 
 	return argv;
 }
@@ -339,6 +357,9 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -fair              Use proportional-share scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -trace             Trace scheduler events, dump at power off.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -356,6 +377,7 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	trace_dump ();
 
 	printf ("This is Gabe! Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -367,6 +389,11 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	kmem_print_stats ();
+#ifdef LOCKSTAT
+	lock_print_stats ();
+#endif
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
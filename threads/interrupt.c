@@ -8,7 +8,10 @@
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/smp.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -99,9 +102,17 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Whether we are processing an external
+   interrupt, and whether to yield on return, is tracked per CPU
+   in struct cpu.
+
+   Vectors 0x20...0x2f come from the PIC, which only interrupts
+   the BSP, and vectors LAPIC_VEC_FIRST...LAPIC_VEC_LAST are
+   interprocessor interrupts, delivered by each CPU's local
+   APIC. */
+#define is_pic_vec(VEC) ((VEC) >= 0x20 && (VEC) <= 0x2f)
+#define is_lapic_vec(VEC) ((VEC) >= LAPIC_VEC_FIRST && (VEC) <= LAPIC_VEC_LAST)
+#define is_external_vec(VEC) (is_pic_vec (VEC) || is_lapic_vec (VEC))
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -173,13 +184,7 @@ intr_init (void) {
 		intr_names[i] = "unknown";
 	}
 
-#ifdef USERPROG
-	/* Load TSS. */
-	ltr (SEL_TSS);
-#endif
-
-	/* Load IDT register. */
-	lidt(&idt_desc);
+	intr_init_ap ();
 
 	/* Initialize intr_names. */
 	intr_names[0] = "#DE Divide Error";
@@ -203,6 +208,20 @@ intr_init (void) {
 	intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT, and the TSS if there is one, on the running
+   CPU.  intr_init() does this for the BSP, and every application
+   processor does it for itself while starting up. */
+void
+intr_init_ap (void) {
+#ifdef USERPROG
+	/* Load TSS. */
+	ltr (SEL_TSS);
+#endif
+
+	/* Load IDT register. */
+	lidt(&idt_desc);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -227,7 +246,7 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external_vec (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,7 +267,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external_vec (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -256,7 +275,9 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
    and false at all other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	/* Before thread_init() there is no struct cpu to look at, but
+	   interrupts are off then anyway. */
+	return cpu_cnt > 0 && this_cpu ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -266,7 +287,7 @@ intr_context (void) {
 void
 intr_yield_on_return (void) {
 	ASSERT (intr_context ());
-	yield_on_return = true;
+	this_cpu ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -331,29 +352,41 @@ pic_end_of_interrupt (int irq) {
 void
 intr_handler (struct intr_frame *frame) {
 	bool external;
+	bool from_user = (frame->cs & 3) == 3;
 	intr_handler_func *handler;
+	struct cpu *c = NULL;
+
+	/* Entering the kernel from user mode ends a stretch of user
+	   time. */
+	if (from_user)
+		thread_charge_user ();
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or the local
+	   APIC (see below).  An external interrupt handler cannot
+	   sleep. */
+	external = is_external_vec (frame->vec_no);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
 
-		in_external_intr = true;
-		yield_on_return = false;
+		c = this_cpu ();
+		c->in_external_intr = true;
+		c->yield_on_return = false;
+		trace (TRACE_IRQ_ENTER, c->curr->tid, frame->vec_no);
 	}
 
 	/* Invoke the interrupt's handler. */
 	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
 		handler (frame);
-	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+			|| frame->vec_no == LAPIC_VEC_SPURIOUS) {
 		/* There is no handler, but this interrupt can trigger
 		   spuriously due to a hardware fault or hardware race
-		   condition.  Ignore it. */
+		   condition.  Ignore it.  (A spurious local APIC interrupt
+		   must not be acknowledged, so it is not external.) */
 	} else {
 		/* No handler and not spurious.  Invoke the unexpected
 		   interrupt handler. */
@@ -366,12 +399,20 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (intr_context ());
 
-		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		c = this_cpu ();
+		c->in_external_intr = false;
+		if (is_pic_vec (frame->vec_no))
+			pic_end_of_interrupt (frame->vec_no);
+		else
+			lapic_eoi ();
 
-		if (yield_on_return)
+		trace (TRACE_IRQ_EXIT, c->curr->tid, frame->vec_no);
+		if (c->yield_on_return)
 			thread_yield ();
 	}
+
+	if (from_user)
+		thread_charge_kernel ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
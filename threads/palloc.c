@@ -7,8 +7,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <list.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -24,13 +27,60 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
-
-/* A memory pool. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free memory is kept in
+   blocks of 2**ORDER pages, aligned to their size relative to the
+   pool's base, on one free list per order.  An allocation takes a
+   block from the smallest order that has one, splitting it in
+   halves as needed, and a freed block merges with its "buddy",
+   the other half of the block it was split from, whenever that is
+   free too.  Both take O(log n) time in the size of the pool.  A
+   request for a number of pages that is not a power of 2 takes
+   the next larger block and gives the tail back right away.
+
+   Single pages, by far the most common request, first go through
+   a per-CPU "magazine" of free pages for each pool.  A CPU takes
+   pages from its own magazines with interrupts off and no lock,
+   and only goes to the pool, under its lock, to refill or drain a
+   magazine MAGAZINE_BATCH pages at a time.  Pages in one CPU's
+   magazine are not available to other CPUs, so a pool can run
+   out while up to MAGAZINE_MAX of its pages sit in each CPU's
+   magazine.
+
+   Idle CPUs also zero free pages ahead of time, with
+   non-temporal stores, and keep up to ZEROED_MAX of them per
+   pool for single-page PAL_ZERO requests, so that those need not
+   clear the page themselves.  The zeroed pages go back to the
+   pool when it runs dry. */
+
+/* Most pre-zeroed pages to keep in each pool. */
+#define ZEROED_MAX 64
+
+/* In debug builds, the free_order of a page that is free but sits
+   in a magazine or on the zeroed list, where used_map still has
+   it as in use, so that freeing it again can be caught. */
+#define PAGE_CACHED 0xff
+
+/* A memory pool.  The lock is a spinlock, not a struct lock,
+   because the scheduler frees the pages of dying threads while
+   it holds sched_lock.
+
+   A free block keeps its free list element in its first page. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
+	struct spinlock lock;           /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *free_order;            /* Per page: 1 + order if it is the
+	                                   first page of a free block,
+	                                   PAGE_CACHED if it is cached,
+	                                   otherwise 0. */
+	struct list free_lists[PALLOC_ORDERS];  /* Free blocks, by order. */
+	size_t free_cnt[PALLOC_ORDERS]; /* Length of each free list. */
+	void *zeroed[ZEROED_MAX];       /* Pages known to be all zeros. */
+	size_t zeroed_cnt;              /* Number of pages in zeroed[]. */
+	long long zeroed_hits;          /* PAL_ZERO pages taken from zeroed[]. */
+	long long idle_zeroed;          /* Pages zeroed by idle CPUs. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +92,13 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static void pool_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void *magazine_get (struct pool *);
+static void magazine_put (struct pool *, void *page);
+static void *zeroed_get (struct pool *);
+static bool zeroed_release (struct pool *);
+static void mark_cached (struct pool *, void *page, bool cached);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +280,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,16 +319,34 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 0)
+		return NULL;
+
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = zeroed_get (pool);
+		if (pages != NULL)
+			return pages;
+	}
+
+	if (page_cnt == 1)
+		pages = magazine_get (pool);
+	else {
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->lock);
+		size_t page_idx = pool_alloc (pool, page_cnt);
+		if (page_idx == BITMAP_ERROR && zeroed_release (pool))
+			page_idx = pool_alloc (pool, page_cnt);
+		spinlock_release (&pool->lock);
+		intr_set_level (old_level);
+
+		if (page_idx != BITMAP_ERROR)
+			pages = pool->base + PGSIZE * page_idx;
+		else
+			pages = NULL;
+	}
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -301,6 +376,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -314,12 +390,23 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 		NOT_REACHED ();
 
 	page_idx = pg_no (pages) - pg_no (pool->base);
+	ASSERT (pool->free_order[page_idx] != PAGE_CACHED);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	if (page_cnt == 1) {
+		ASSERT (bitmap_test (pool->used_map, page_idx));
+		magazine_put (pool, pages);
+		return;
+	}
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_free (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,18 +415,308 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Returns the current CPU's magazine for POOL.  Interrupts must
+   be off. */
+static struct page_magazine *
+magazine (struct pool *pool) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	return &this_cpu ()->magazines[pool == &user_pool];
+}
+
+/* Moves up to MAGAZINE_BATCH free pages from POOL into M, which
+   is empty.  POOL's lock must be held. */
+static void
+magazine_refill (struct page_magazine *m, struct pool *pool) {
+	ASSERT (spinlock_held (&pool->lock));
+
+	while (m->cnt < MAGAZINE_BATCH) {
+		size_t page_idx = pool_alloc (pool, 1);
+		if (page_idx == BITMAP_ERROR)
+			break;
+		m->pages[m->cnt++] = pool->base + PGSIZE * page_idx;
+		mark_cached (pool, m->pages[m->cnt - 1], true);
+	}
+}
+
+/* Takes a free page out of the current CPU's magazine for POOL,
+   first refilling the magazine from POOL if it is empty.
+   Returns a null pointer if POOL has no free pages either. */
+static void *
+magazine_get (struct pool *pool) {
+	struct page_magazine *m;
+	enum intr_level old_level;
+	void *page = NULL;
+
+	old_level = intr_disable ();
+	m = magazine (pool);
+	if (m->cnt > 0)
+		m->hits++;
+	else {
+		spinlock_acquire (&pool->lock);
+		magazine_refill (m, pool);
+		if (m->cnt == 0 && zeroed_release (pool))
+			magazine_refill (m, pool);
+		spinlock_release (&pool->lock);
+		if (m->cnt > 0)
+			m->refills++;
+		else
+			m->misses++;
+	}
+	if (m->cnt > 0) {
+		page = m->pages[--m->cnt];
+		mark_cached (pool, page, false);
+	}
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Puts PAGE, a page from POOL that is no longer in use, into
+   the current CPU's magazine for POOL, first draining the oldest
+   MAGAZINE_BATCH pages back to POOL if the magazine is full.  May
+   be called with sched_lock held. */
+static void
+magazine_put (struct pool *pool, void *page) {
+	struct page_magazine *m;
+	enum intr_level old_level;
+	int i;
+
+	old_level = intr_disable ();
+	m = magazine (pool);
+	if (m->cnt == MAGAZINE_MAX) {
+		spinlock_acquire (&pool->lock);
+		for (i = 0; i < MAGAZINE_BATCH; i++) {
+			mark_cached (pool, m->pages[i], false);
+			pool_free (pool, pg_no (m->pages[i]) - pg_no (pool->base), 1);
+		}
+		spinlock_release (&pool->lock);
+		m->cnt -= MAGAZINE_BATCH;
+		memmove (m->pages, m->pages + MAGAZINE_BATCH,
+		         m->cnt * sizeof *m->pages);
+		m->drains++;
+	}
+	m->pages[m->cnt++] = page;
+	mark_cached (pool, page, true);
+	intr_set_level (old_level);
+}
+
+/* In debug builds, marks PAGE, a page from POOL, as cached if
+   CACHED is true, otherwise as in use.  The caller must own PAGE,
+   by holding POOL's lock or the magazine PAGE is in. */
+static void
+mark_cached (struct pool *pool UNUSED, void *page UNUSED,
+             bool cached UNUSED) {
+#ifndef NDEBUG
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+	ASSERT (pool->free_order[page_idx] == (cached ? 0 : PAGE_CACHED));
+	pool->free_order[page_idx] = cached ? PAGE_CACHED : 0;
+#endif
+}
+
+/* Fills PAGE with zeros using non-temporal stores, which bypass
+   the cache, so that zeroing pages nobody is about to touch does
+   not evict data somebody is. */
+static void
+zero_page_nt (void *page) {
+	uint64_t *p = page;
+	size_t i;
+
+	for (i = 0; i < PGSIZE / sizeof *p; i += 4)
+		asm volatile ("movnti %1, 0(%0)\n\t"
+		              "movnti %1, 8(%0)\n\t"
+		              "movnti %1, 16(%0)\n\t"
+		              "movnti %1, 24(%0)"
+		              : : "r" (p + i), "r" (0UL) : "memory");
+
+	/* Make the stores visible before the page is handed out. */
+	asm volatile ("sfence" : : : "memory");
+}
+
+/* Takes a pre-zeroed page out of POOL, or returns a null pointer
+   if it has none. */
+static void *
+zeroed_get (struct pool *pool) {
+	enum intr_level old_level;
+	void *page = NULL;
+
+	/* Not worth the lock if there is surely nothing there. */
+	if (__atomic_load_n (&pool->zeroed_cnt, __ATOMIC_RELAXED) == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	if (pool->zeroed_cnt > 0) {
+		page = pool->zeroed[--pool->zeroed_cnt];
+		pool->zeroed_hits++;
+		mark_cached (pool, page, false);
+	}
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Gives all of POOL's pre-zeroed pages back to it.  Returns true
+   if there were any.  POOL's lock must be held. */
+static bool
+zeroed_release (struct pool *pool) {
+	bool released = pool->zeroed_cnt > 0;
+
+	ASSERT (spinlock_held (&pool->lock));
+
+	while (pool->zeroed_cnt > 0) {
+		void *page = pool->zeroed[--pool->zeroed_cnt];
+		mark_cached (pool, page, false);
+		pool_free (pool, pg_no (page) - pg_no (pool->base), 1);
+	}
+	return released;
+}
+
+/* Zeroes one free page for later PAL_ZERO requests, from the
+   user pool if it has room for more zeroed pages, otherwise from
+   the kernel pool.  Returns false if there was nothing to do.
+   Called by idle threads, with interrupts on. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pools[] = { &user_pool, &kernel_pool };
+	enum intr_level old_level;
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *pool = pools[i];
+		size_t page_idx = BITMAP_ERROR;
+		void *page;
+
+		if (__atomic_load_n (&pool->zeroed_cnt, __ATOMIC_RELAXED) >= ZEROED_MAX)
+			continue;
+
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->lock);
+		if (pool->zeroed_cnt < ZEROED_MAX)
+			page_idx = pool_alloc (pool, 1);
+		spinlock_release (&pool->lock);
+		intr_set_level (old_level);
+		if (page_idx == BITMAP_ERROR)
+			continue;
+
+		/* The page is ours while we zero it. */
+		page = pool->base + PGSIZE * page_idx;
+		zero_page_nt (page);
+
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->lock);
+		if (pool->zeroed_cnt < ZEROED_MAX) {
+			pool->zeroed[pool->zeroed_cnt++] = page;
+			pool->idle_zeroed++;
+			mark_cached (pool, page, true);
+		} else
+			pool_free (pool, page_idx, 1);
+		spinlock_release (&pool->lock);
+		intr_set_level (old_level);
+		return true;
+	}
+	return false;
+}
+
+/* Stores in CNT[ORDER] the number of free blocks of 2**ORDER
+   pages in the user pool if PAL_USER is set in FLAGS, otherwise
+   in the kernel pool.  Pages in magazines and pre-zeroed pages
+   are not counted. */
+void
+palloc_get_free_blocks (enum palloc_flags flags, size_t cnt[PALLOC_ORDERS]) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	memcpy (cnt, pool->free_cnt, sizeof pool->free_cnt);
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+}
+
+/* Stores in *STATS how the user pool's pre-zeroed pages are
+   doing if PAL_USER is set in FLAGS, otherwise the kernel
+   pool's. */
+void
+palloc_get_zero_stats (enum palloc_flags flags,
+                       struct palloc_zero_stats *stats) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	stats->ready = pool->zeroed_cnt;
+	stats->idle_zeroed = pool->idle_zeroed;
+	stats->hits = pool->zeroed_hits;
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+}
+
+/* Prints the number of free pages in each pool and how they
+   are split up into blocks, then how well the magazines do. */
+void
+palloc_print_stats (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	const char *names[] = { "kernel", "user" };
+	size_t i;
+	int order, c;
+
+	for (i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *p = pools[i];
+		size_t free_pages = 0, cached = 0;
+		long long hits = 0, refills = 0, misses = 0, drains = 0;
+
+		for (order = 0; order < PALLOC_ORDERS; order++)
+			free_pages += p->free_cnt[order] << order;
+		for (c = 0; c < cpu_cnt; c++) {
+			struct page_magazine *m = &cpus[c].magazines[i];
+			cached += m->cnt;
+			hits += m->hits;
+			refills += m->refills;
+			misses += m->misses;
+			drains += m->drains;
+		}
+		printf ("Palloc: %s pool %zu of %zu pages free, %zu in magazines\n",
+				names[i], free_pages, bitmap_size (p->used_map), cached);
+		printf ("  free blocks by order:");
+		for (order = 0; order < PALLOC_ORDERS; order++)
+			if (p->free_cnt[order] != 0)
+				printf (" %d:%zu", order, p->free_cnt[order]);
+		printf ("\n");
+		printf ("  magazines: %lld hits, %lld refills, %lld drains, "
+				"%lld out of pages", hits, refills, drains, misses);
+		if (hits + refills > 0)
+			printf (", %lld%% hit rate", hits * 100 / (hits + refills));
+		printf ("\n");
+		printf ("  zeroed pages: %zu ready, %lld zeroed while idle, "
+				"%lld handed out\n",
+				p->zeroed_cnt, p->idle_zeroed, p->zeroed_hits);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's used_map and free_order at its base.
+     Calculate the space needed for them and subtract it from the
+     pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_bytes = bitmap_buf_size (pgcnt);
+	size_t bm_pages = DIV_ROUND_UP (bm_bytes + pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	spinlock_init (&p->lock);
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_bytes);
 	p->base = (void *) start;
+	p->free_order = (uint8_t *) *bm_base + bm_bytes;
+	memset (p->free_order, 0, pgcnt);
+	for (order = 0; order < PALLOC_ORDERS; order++) {
+		list_init (&p->free_lists[order]);
+		p->free_cnt[order] = 0;
+	}
+	p->zeroed_cnt = 0;
+	p->zeroed_hits = p->idle_zeroed = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
@@ -347,6 +724,108 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	*bm_base += bm_pages;
 }
 
+/* Returns the free list element kept in page PAGE_IDX of P. */
+static struct list_elem *
+block_elem (struct pool *p, size_t page_idx) {
+	return (struct list_elem *) (p->base + PGSIZE * page_idx);
+}
+
+/* Puts the block of 2**ORDER pages at PAGE_IDX on P's free
+   lists, without merging. */
+static void
+push_block (struct pool *p, size_t page_idx, int order) {
+	list_push_front (&p->free_lists[order], block_elem (p, page_idx));
+	p->free_order[page_idx] = order + 1;
+	p->free_cnt[order]++;
+}
+
+/* Takes the free block of 2**ORDER pages at PAGE_IDX off P's
+   free lists. */
+static void
+remove_block (struct pool *p, size_t page_idx, int order) {
+	ASSERT (p->free_order[page_idx] == order + 1);
+
+	list_remove (block_elem (p, page_idx));
+	p->free_order[page_idx] = 0;
+	p->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in P, merging it
+   with its buddy for as long as the buddy is free. */
+static void
+free_block (struct pool *p, size_t page_idx, int order) {
+	size_t pgcnt = bitmap_size (p->used_map);
+
+	while (order < PALLOC_ORDERS - 1) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+		if (buddy + ((size_t) 1 << order) > pgcnt
+				|| p->free_order[buddy] != order + 1)
+			break;
+		remove_block (p, buddy, order);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	push_block (p, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in P, as the largest
+   aligned blocks that fit.  P's lock must be held, unless the
+   pool is still being set up. */
+static void
+pool_free (struct pool *p, size_t page_idx, size_t page_cnt) {
+	bitmap_set_multiple (p->used_map, page_idx, page_cnt, false);
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < PALLOC_ORDERS - 1
+				&& page_idx % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (p, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from P and returns the
+   index of the first one, or BITMAP_ERROR if P has no free block
+   big enough.  P's lock must be held. */
+static size_t
+pool_alloc (struct pool *p, size_t page_cnt) {
+	size_t page_idx, block_cnt;
+	int order = 0, want;
+
+	ASSERT (spinlock_held (&p->lock));
+
+	while (order < PALLOC_ORDERS && ((size_t) 1 << order) < page_cnt)
+		order++;
+	want = order;
+	while (order < PALLOC_ORDERS && list_empty (&p->free_lists[order]))
+		order++;
+	if (order >= PALLOC_ORDERS)
+		return BITMAP_ERROR;
+
+	page_idx = (uint8_t *) list_front (&p->free_lists[order]) - p->base;
+	page_idx /= PGSIZE;
+	remove_block (p, page_idx, order);
+
+	/* Split down to the size we want, keeping the lower half. */
+	while (order > want) {
+		order--;
+		push_block (p, page_idx + ((size_t) 1 << order), order);
+	}
+
+	/* Give back what we do not need. */
+	block_cnt = (size_t) 1 << order;
+	if (page_cnt < block_cnt)
+		pool_free (p, page_idx + page_cnt, block_cnt - page_cnt);
+
+	ASSERT (!bitmap_contains (p->used_map, page_idx, page_cnt, true));
+	bitmap_set_multiple (p->used_map, page_idx, page_cnt, true);
+	return page_idx;
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
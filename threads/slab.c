@@ -0,0 +1,393 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches, or "slab allocator".
+
+   A cache hands out objects of a single size, given when the
+   cache is created, rounded up only as far as the requested
+   alignment.  It carves them out of "slabs", one page each: a
+   struct slab header, then a stack of the indexes of the slab's
+   free objects, then the objects.  So the slab an object belongs
+   to is just the page it is on.
+
+   Every slab is on one of three lists, according to how many of
+   its objects are free: partial, full or empty.  Allocation takes
+   from partial slabs first, so that objects pack into as few
+   slabs as possible, and a cache keeps at most KMEM_EMPTY_MAX
+   empty slabs, giving any more back to the page allocator.
+
+   In front of the slabs, each CPU has a "magazine" of up to
+   KMEM_MAG_MAX free objects for each cache.  A CPU allocates from
+   and frees into its own magazine with interrupts off and no
+   lock.  Only when its magazine is empty or full does it take the
+   cache's lock, to move KMEM_MAG_BATCH objects at once.
+
+   A cache may have a constructor, which runs once on each object
+   when its slab is created.  Objects must be freed in their
+   constructed state, and the cache hands them out that way.
+   Objects of caches without one are filled with 0xcc on free in
+   debug builds, like malloc() blocks, to help catch
+   use-after-free bugs. */
+
+/* Magic number for telling slabs from other pages. */
+#define SLAB_MAGIC 0x51ab51ab
+
+#define KMEM_MAG_MAX 16         /* Most objects in a magazine. */
+#define KMEM_MAG_BATCH 8        /* Objects moved to or from slabs at once. */
+#define KMEM_EMPTY_MAX 1        /* Most empty slabs a cache keeps. */
+
+/* A CPU's free objects from one cache. */
+struct kmem_magazine {
+	int cnt;                    /* Number of objects in objs[]. */
+	void *objs[KMEM_MAG_MAX];   /* Free objects, most recently freed last. */
+};
+
+/* An object cache. */
+struct kmem_cache {
+	char name[KMEM_NAME_LEN];   /* Name, for statistics. */
+	size_t size;                /* Object size, rounded up to alignment. */
+	size_t obj_cnt;             /* Objects per slab. */
+	size_t obj_ofs;             /* Offset of the first object in a slab. */
+	kmem_ctor_func *ctor;       /* Constructor, or null. */
+	struct list_elem elem;      /* Element in all_caches. */
+
+	struct spinlock lock;       /* Protects the members below. */
+	struct list partial;        /* Slabs with some objects free. */
+	struct list full;           /* Slabs with no objects free. */
+	struct list empty;          /* Slabs with all objects free. */
+	size_t slab_cnt;            /* Slabs on all three lists. */
+	size_t empty_cnt;           /* Slabs on the empty list. */
+	size_t out_cnt;             /* Objects out of their slabs. */
+	size_t created_cnt;         /* Slabs ever created. */
+
+	/* Each CPU's magazine, only touched by that CPU. */
+	struct kmem_magazine mags[CPU_MAX];
+};
+
+/* Header at the start of a slab. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of cache's lists. */
+	size_t free_cnt;            /* Number of free objects. */
+	uint16_t free_idx[];        /* Indexes of free objects, a stack. */
+};
+
+/* Every cache, for kmem_print_stats(). */
+static struct list all_caches;
+static struct spinlock all_caches_lock;
+
+static size_t slab_layout (size_t size, size_t align, size_t *obj_ofs);
+static void magazine_refill (struct kmem_cache *, struct kmem_magazine *);
+static void magazine_drain (struct kmem_cache *, struct kmem_magazine *);
+
+/* Initializes the object cache allocator. */
+void
+kmem_init (void) {
+	list_init (&all_caches);
+	spinlock_init (&all_caches_lock);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes each,
+   aligned on ALIGN bytes, which must be a power of 2, or on the
+   size of a pointer if ALIGN is 0.  If CTOR is nonnull, it
+   initializes each object once, as described at the top of this
+   file.  NAME identifies the cache in kmem_print_stats().
+
+   Returns a null pointer if SIZE is too big for an object to fit
+   in a slab or if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor) {
+	struct kmem_cache *c;
+	enum intr_level old_level;
+	size_t obj_cnt, obj_ofs;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+
+	if (align == 0)
+		align = sizeof (void *);
+	ASSERT ((align & (align - 1)) == 0);
+	size = ROUND_UP (size, align);
+	obj_cnt = slab_layout (size, align, &obj_ofs);
+	if (obj_cnt == 0)
+		return NULL;
+
+	c = palloc_get_multiple (PAL_ZERO, DIV_ROUND_UP (sizeof *c, PGSIZE));
+	if (c == NULL)
+		return NULL;
+	strlcpy (c->name, name, sizeof c->name);
+	c->size = size;
+	c->obj_cnt = obj_cnt;
+	c->obj_ofs = obj_ofs;
+	c->ctor = ctor;
+	spinlock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	spinlock_release (&all_caches_lock);
+	intr_set_level (old_level);
+	return c;
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available.  May be called with
+   interrupts off, but not from an interrupt handler, since the
+   constructor may run. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct kmem_magazine *m;
+	enum intr_level old_level;
+	void *obj = NULL;
+
+	ASSERT (c != NULL);
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	m = &c->mags[this_cpu ()->id];
+	if (m->cnt == 0)
+		magazine_refill (c, m);
+	if (m->cnt > 0)
+		obj = m->objs[--m->cnt];
+	intr_set_level (old_level);
+	return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C.
+   Does nothing if OBJ is a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct kmem_magazine *m;
+	enum intr_level old_level;
+
+	if (obj == NULL)
+		return;
+	ASSERT (kmem_cache_of (obj) == c);
+	ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->size == 0);
+
+#ifndef NDEBUG
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->size);
+#endif
+	old_level = intr_disable ();
+	m = &c->mags[this_cpu ()->id];
+	if (m->cnt == KMEM_MAG_MAX)
+		magazine_drain (c, m);
+	m->objs[m->cnt++] = obj;
+	intr_set_level (old_level);
+}
+
+/* Returns the cache that OBJ was obtained from, or a null
+   pointer if OBJ is not in a slab.  OBJ must be in a page
+   obtained from the page allocator. */
+struct kmem_cache *
+kmem_cache_of (const void *obj) {
+	const struct slab *s = pg_round_down (obj);
+
+	return s->magic == SLAB_MAGIC ? s->cache : NULL;
+}
+
+/* Returns the size of C's objects, which may be a little more
+   than was asked for when C was created. */
+size_t
+kmem_cache_size (const struct kmem_cache *c) {
+	return c->size;
+}
+
+/* Stores C's current statistics in *STATS. */
+void
+kmem_cache_get_stats (struct kmem_cache *c, struct kmem_stats *stats) {
+	enum intr_level old_level;
+	size_t cached = 0;
+	int i;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&c->lock);
+	for (i = 0; i < cpu_cnt; i++)
+		cached += c->mags[i].cnt;
+	stats->obj_cnt = c->obj_cnt;
+	stats->slab_cnt = c->slab_cnt;
+	stats->created_cnt = c->created_cnt;
+	stats->in_use = c->out_cnt - cached;
+	stats->cached = cached;
+	spinlock_release (&c->lock);
+	intr_set_level (old_level);
+}
+
+/* Prints how much memory each cache that has any is using. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+	     e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		size_t cached = 0, in_use;
+		int i;
+
+		if (c->slab_cnt == 0)
+			continue;
+		for (i = 0; i < cpu_cnt; i++)
+			cached += c->mags[i].cnt;
+		in_use = c->out_cnt - cached;
+		printf ("Slab: %-*s %4zu B x %5zu in use, %4zu slabs (%zu kB), "
+				"%zu%% used\n",
+				KMEM_NAME_LEN - 1, c->name, c->size, in_use, c->slab_cnt,
+				c->slab_cnt * PGSIZE / 1024,
+				in_use * c->size * 100 / (c->slab_cnt * PGSIZE));
+	}
+}
+
+/* Returns the number of objects of SIZE bytes, aligned on ALIGN
+   bytes, that fit in a slab, and stores the offset of the first
+   one in *OBJ_OFS.  Returns 0 if not even one fits. */
+static size_t
+slab_layout (size_t size, size_t align, size_t *obj_ofs) {
+	size_t n;
+
+	for (n = (PGSIZE - sizeof (struct slab)) / (size + sizeof (uint16_t));
+	     n > 0; n--) {
+		size_t ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+		                       align);
+		if (ofs + n * size <= PGSIZE) {
+			*obj_ofs = ofs;
+			return n;
+		}
+	}
+	return 0;
+}
+
+/* Returns object IDX in slab S of cache C. */
+static void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx) {
+	return (uint8_t *) s + c->obj_ofs + idx * c->size;
+}
+
+/* Allocates and returns a new slab for cache C, with all of its
+   objects free and constructed, or a null pointer if memory is
+   not available.  The slab is not on any of C's lists yet. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->obj_cnt;
+	for (i = 0; i < c->obj_cnt; i++) {
+		s->free_idx[i] = c->obj_cnt - 1 - i;
+		if (c->ctor != NULL)
+			c->ctor (slab_obj (c, s, i));
+	}
+	return s;
+}
+
+/* Puts slab S on the list of cache C that matches its number of
+   free objects.  C's lock must be held. */
+static void
+slab_file (struct kmem_cache *c, struct slab *s) {
+	if (s->free_cnt == c->obj_cnt) {
+		list_push_front (&c->empty, &s->elem);
+		c->empty_cnt++;
+	} else if (s->free_cnt == 0)
+		list_push_front (&c->full, &s->elem);
+	else
+		list_push_front (&c->partial, &s->elem);
+}
+
+/* Takes slab S off whichever list of cache C it is on.  C's lock
+   must be held. */
+static void
+slab_unfile (struct kmem_cache *c, struct slab *s) {
+	if (s->free_cnt == c->obj_cnt)
+		c->empty_cnt--;
+	list_remove (&s->elem);
+}
+
+/* Fills magazine M of cache C, which is empty, with up to
+   KMEM_MAG_BATCH objects, taken from partial slabs first, then
+   from empty ones, then from a new slab.  Interrupts must be
+   off. */
+static void
+magazine_refill (struct kmem_cache *c, struct kmem_magazine *m) {
+	struct slab *s;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->lock);
+	if (list_empty (&c->partial) && list_empty (&c->empty)) {
+		/* Build the slab without the lock; the constructor may
+		   take a while. */
+		spinlock_release (&c->lock);
+		s = slab_create (c);
+		if (s == NULL)
+			return;
+		spinlock_acquire (&c->lock);
+		c->slab_cnt++;
+		c->created_cnt++;
+		slab_file (c, s);
+	}
+
+	while (m->cnt < KMEM_MAG_BATCH) {
+		if (!list_empty (&c->partial))
+			s = list_entry (list_front (&c->partial), struct slab, elem);
+		else if (!list_empty (&c->empty))
+			s = list_entry (list_front (&c->empty), struct slab, elem);
+		else
+			break;
+
+		slab_unfile (c, s);
+		m->objs[m->cnt++] = slab_obj (c, s, s->free_idx[--s->free_cnt]);
+		c->out_cnt++;
+		slab_file (c, s);
+	}
+	spinlock_release (&c->lock);
+}
+
+/* Returns the KMEM_MAG_BATCH least recently freed objects in
+   magazine M of cache C, which is full, to their slabs.
+   Interrupts must be off. */
+static void
+magazine_drain (struct kmem_cache *c, struct kmem_magazine *m) {
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&c->lock);
+	for (i = 0; i < KMEM_MAG_BATCH; i++) {
+		void *obj = m->objs[i];
+		struct slab *s = pg_round_down (obj);
+
+		slab_unfile (c, s);
+		s->free_idx[s->free_cnt++] = (pg_ofs (obj) - c->obj_ofs) / c->size;
+		c->out_cnt--;
+		if (s->free_cnt == c->obj_cnt && c->empty_cnt >= KMEM_EMPTY_MAX) {
+			/* Enough empty slabs already. */
+			s->magic = 0;
+			c->slab_cnt--;
+			palloc_free_page (s);
+		} else
+			slab_file (c, s);
+	}
+	spinlock_release (&c->lock);
+
+	m->cnt -= KMEM_MAG_BATCH;
+	memmove (m->objs, m->objs + KMEM_MAG_BATCH, m->cnt * sizeof *m->objs);
+}
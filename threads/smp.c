@@ -0,0 +1,228 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/fpu.h"
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/tss.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   The BSP boots the kernel as usual.  smp_init() then starts
+   every application processor (AP) with the startup code in
+   ap-start.S, and each AP sets up its own descriptor tables,
+   TSS, syscall MSRs and local APIC in ap_main() before entering
+   its idle loop.  From then on all CPUs run threads from their
+   own run queues; see thread.c.
+
+   The PIT keeps interrupting only the BSP.  The BSP forwards
+   each timer tick to the other CPUs as an IPI, so time slices
+   and the 4.4BSD scheduler's accounting work the same way on
+   every CPU, and the system clock and sleeping threads are only
+   ever handled by the BSP. */
+
+/* All CPUs. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt;
+
+/* AP startup code and data, in ap-start.S. */
+extern uint8_t ap_trampoline[], ap_trampoline_end[];
+extern uint64_t ap_kernel_cr3;
+extern uint64_t ap_stacks[CPU_MAX - 1];
+extern uint32_t ap_boot_cr3;
+extern uint32_t ap_next;
+
+/* Boot page table, in start.S. */
+extern uint64_t boot_pml4e[];
+
+/* Converts SYM, the address of a symbol in the AP startup code,
+   to the address of the same symbol in the copy at
+   AP_TRAMPOLINE. */
+#define TRAMPOLINE(SYM) \
+	((void *) ((uint8_t *) ptov (AP_TRAMPOLINE) \
+	           + ((uint8_t *) (SYM) - ap_trampoline)))
+
+/* syscall-entry.S depends on this layout. */
+_Static_assert (offsetof (struct cpu, syscall_scratch) == 0, "scratch");
+_Static_assert (offsetof (struct cpu, tss) == 16, "tss");
+
+/* TLB shootdown generation, bumped by every smp_flush_tlb(). */
+static uint64_t tlb_gen;
+
+static intr_handler_func tick_interrupt, reschedule_interrupt;
+static intr_handler_func flush_tlb_interrupt;
+static void flush_tlb_if_behind (void);
+void ap_main (void) NO_RETURN;
+
+/* Starts the application processors and waits for them to join
+   the scheduler.  Must be called by the initial thread, with
+   interrupts on, after timer_calibrate(). */
+void
+smp_init (void) {
+	uint64_t *stacks = TRAMPOLINE (ap_stacks);
+	enum intr_level old_level;
+	int started;
+	int i;
+
+	ASSERT (intr_get_level () == INTR_ON);
+	ASSERT (ap_trampoline_end - ap_trampoline <= PGSIZE);
+
+	old_level = intr_disable ();
+	lapic_init ();
+	cpus[0].apic_id = lapic_id ();
+	intr_set_level (old_level);
+
+	intr_register_ext (LAPIC_VEC_TICK, tick_interrupt, "IPI Timer");
+	intr_register_ext (LAPIC_VEC_RESCHEDULE, reschedule_interrupt,
+	                   "IPI Reschedule");
+	intr_register_ext (LAPIC_VEC_FLUSH_TLB, flush_tlb_interrupt,
+	                   "IPI TLB flush");
+
+	/* Copy the startup code to low memory and give every AP that
+	   might show up an idle thread. */
+	memcpy (ptov (AP_TRAMPOLINE), ap_trampoline,
+	        ap_trampoline_end - ap_trampoline);
+	*(uint32_t *) TRAMPOLINE (&ap_boot_cr3) = vtop (boot_pml4e);
+	*(uint64_t *) TRAMPOLINE (&ap_kernel_cr3) = vtop (base_pml4);
+	for (i = 1; i < CPU_MAX; i++) {
+		cpus[i].id = i;
+		stacks[i - 1] = (uint64_t) thread_init_ap (&cpus[i]);
+	}
+
+	/* There is no ACPI table parser to tell us how many CPUs
+	   there are, so wake up all of them and see who answers. */
+	lapic_start_aps (AP_TRAMPOLINE / PGSIZE);
+	timer_msleep (100);
+
+	/* Close the door on latecomers: any AP that comes along now
+	   finds no free slot and halts. */
+	started = __atomic_exchange_n ((uint32_t *) TRAMPOLINE (&ap_next),
+	                               CPU_MAX, __ATOMIC_SEQ_CST);
+	if (started > CPU_MAX - 1)
+		started = CPU_MAX - 1;
+	for (i = 1; i <= started; i++)
+		while (!cpus[i].started)
+			asm volatile ("pause" : : : "memory");
+	for (i = started + 1; i < CPU_MAX; i++) {
+		palloc_free_page (cpus[i].idle_thread);
+		cpus[i].idle_thread = cpus[i].curr = NULL;
+	}
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	cpu_cnt = started + 1;
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+
+	if (cpu_cnt > 1)
+		printf ("SMP: %d CPUs online.\n", cpu_cnt);
+}
+
+/* Asks CPU C to look at its run queue again, because a thread
+   that should preempt its running thread was just put there. */
+void
+smp_reschedule (struct cpu *c) {
+	ASSERT (c != this_cpu ());
+	lapic_send_ipi (c->apic_id, LAPIC_VEC_RESCHEDULE);
+}
+
+/* Forwards a timer tick from the BSP to the other CPUs. */
+void
+smp_broadcast_tick (void) {
+	if (cpu_cnt > 1)
+		lapic_broadcast_ipi (LAPIC_VEC_TICK);
+}
+
+/* Makes every CPU drop the kernel mappings in its TLB, and
+   waits until they all have, so that a kernel virtual page that
+   was unmapped before the call may be mapped to something else
+   afterward.  Kernel pages are not global, so reloading CR3 is
+   enough.
+
+   Other CPUs must be able to take the IPI, so the caller must
+   not hold a spinlock.  Two CPUs may shoot down at once: each
+   flushes for the other while it waits. */
+void
+smp_flush_tlb (void) {
+	enum intr_level old_level = intr_disable ();
+	struct cpu *self = this_cpu ();
+	uint64_t gen;
+	int i;
+
+	gen = __atomic_add_fetch (&tlb_gen, 1, __ATOMIC_SEQ_CST);
+	flush_tlb_if_behind ();
+
+	for (i = 0; i < cpu_cnt; i++)
+		if (&cpus[i] != self)
+			lapic_send_ipi (cpus[i].apic_id, LAPIC_VEC_FLUSH_TLB);
+	for (i = 0; i < cpu_cnt; i++)
+		while (__atomic_load_n (&cpus[i].tlb_gen, __ATOMIC_ACQUIRE) < gen) {
+			flush_tlb_if_behind ();
+			asm volatile ("pause");
+		}
+	intr_set_level (old_level);
+}
+
+/* Flushes the running CPU's TLB if a shootdown has been asked
+   for since it last did.  Interrupts must be off. */
+static void
+flush_tlb_if_behind (void) {
+	struct cpu *c = this_cpu ();
+	uint64_t gen = __atomic_load_n (&tlb_gen, __ATOMIC_SEQ_CST);
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (c->tlb_gen < gen) {
+		lcr3 (rcr3 ());
+		__atomic_store_n (&c->tlb_gen, gen, __ATOMIC_RELEASE);
+	}
+}
+
+/* Timer tick forwarded by the BSP. */
+static void
+tick_interrupt (struct intr_frame *args UNUSED) {
+	thread_tick ();
+}
+
+/* Another CPU changed our run queue.  If we are idle, just
+   waking up from `hlt' is enough. */
+static void
+reschedule_interrupt (struct intr_frame *args UNUSED) {
+	check_and_preempt ();
+}
+
+/* Another CPU unmapped kernel pages. */
+static void
+flush_tlb_interrupt (struct intr_frame *args UNUSED) {
+	flush_tlb_if_behind ();
+}
+
+/* Called by ap-start.S on every application processor, with
+   interrupts off, on the stack of the AP's idle thread. */
+void
+ap_main (void) {
+#ifdef USERPROG
+	tss_init ();
+	gdt_init ();
+#endif
+	intr_init_ap ();
+#ifdef USERPROG
+	syscall_init_cpu ();
+	fpu_init_cpu ();
+#endif
+	lapic_init ();
+	this_cpu ()->apic_id = lapic_id ();
+
+	thread_start_ap ();
+}
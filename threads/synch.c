@@ -30,41 +30,239 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+#ifdef LOCKSTAT
+#include "intrinsic.h"
+
+/* synch.h wraps these to pass a lock_stat for each call site.
+   Here they are the plain versions, with no statistics. */
+#undef spinlock_init
+#undef sema_init
+#undef lock_init
+
+static void lock_stat_register (struct lock_stat *);
+static void lock_stat_acquired (struct lock_stat *, bool contended,
+                                uint64_t wait);
+static void lock_stat_released (struct lock_stat *, uint64_t hold);
+#endif
+
+// waitqueue 정렬 기준. 우선순위가 높은 스레드가 top, 같으면 먼저 온 스레드가 top.
+static bool waiter_less(const struct heap_elem *a,
+                        const struct heap_elem *b, void *aux UNUSED)
+{
+	struct thread *t_a = heap_entry(a, struct thread, wait_elem);
+	struct thread *t_b = heap_entry(b, struct thread, wait_elem);
+	if (t_a->priority != t_b->priority)
+		return t_a->priority > t_b->priority;
+	return t_a->wait_seq < t_b->wait_seq;
+}
 
-/* One semaphore in a list. */
-// 현재 스레드가 사용할 "자기 전용 이진 세마포어".
-struct semaphore_elem {
-	// 참고: elem의 멤버는 struct list_elem *prev, *next;
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
-
+// lock->donors 정렬 기준. 우선순위가 높은 스레드가 top.
+static bool donor_less(const struct heap_elem *a,
+					   const struct heap_elem *b, void *aux UNUSED)
+{
+	struct thread *st_a = heap_entry(a, struct thread, donor_elem);
+	struct thread *st_b = heap_entry(b, struct thread, donor_elem);
+	return st_a->priority > st_b->priority;
+}
 
-// 두 sema의 'waiters list내 스레드 중 제일 높은 priority'를 비교
-// a가 높으면 true, b가 높으면 false.
-bool sema_priority_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+// thread->held_locks 정렬 기준. 가장 높은 기부를 받은 락이 top.
+bool held_lock_less(const struct heap_elem *a,
+					const struct heap_elem *b, void *aux UNUSED)
 {
-	struct semaphore_elem *sema_a = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(b, struct semaphore_elem, elem);
+	struct lock_hold *hold_a = heap_entry(a, struct lock_hold, elem);
+	struct lock_hold *hold_b = heap_entry(b, struct lock_hold, elem);
+	return hold_a->max_priority > hold_b->max_priority;
+}
+
+/* Initializes spinlock LOCK. */
+void
+spinlock_init (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+	lock->holder = NULL;
+#ifdef LOCKSTAT
+	lock->stat = NULL;
+#endif
+}
+
+/* Acquires LOCK, spinning until it becomes available.  Interrupts
+   must be off, and the lock must not already be held by the
+   current CPU. */
+void
+spinlock_acquire (struct spinlock *lock) {
+#ifdef LOCKSTAT
+	uint64_t start = rdtsc ();
+	bool contended;
+#endif
 
-	struct list *waiters_a = &(sema_a->semaphore.waiters);
-	struct list *waiters_b = &(sema_b->semaphore.waiters);
+	ASSERT (lock != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (spinlock_held (lock))
+		PANIC ("recursive spinlock acquisition");
+#ifdef LOCKSTAT
+	contended = lock->locked != 0;
+#endif
+
+	/* Spin on a plain read, which stays in this CPU's cache, and
+	   only retry the locked exchange once the lock looks free. */
+	while (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE))
+		while (lock->locked)
+			asm volatile ("pause");
+	lock->holder = this_cpu ();
+#ifdef LOCKSTAT
+	lock->acquired_tsc = rdtsc ();
+	lock_stat_acquired (lock->stat, contended, lock->acquired_tsc - start);
+#endif
+}
 
-	struct thread *root_a = list_entry(list_begin(waiters_a), struct thread, elem);
-	struct thread *root_b = list_entry(list_begin(waiters_b), struct thread, elem);
+/* Releases LOCK, which must be held by the current CPU. */
+void
+spinlock_release (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (spinlock_held (lock));
 
-	return root_a->priority > root_b->priority;
+#ifdef LOCKSTAT
+	lock_stat_released (lock->stat, rdtsc () - lock->acquired_tsc);
+#endif
+	lock->holder = NULL;
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
 }
 
-// donation_elem의 priority를 기준으로 비교
-// a가 높으면 true, b가 높으면 false.
-bool donation_priority_cmp(const struct list_elem *a,
-						   const struct list_elem *b, void *aux UNUSED)
-{
-	struct thread *st_a = list_entry(a, struct thread, donation_elem);
-	struct thread *st_b = list_entry(b, struct thread, donation_elem);
-	return st_a->priority > st_b->priority;
+/* Returns true if the current CPU holds LOCK, false otherwise.
+   Interrupts must be off, or the answer could change before the
+   caller looks at it. */
+bool
+spinlock_held (const struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock->locked && lock->holder == this_cpu ();
+}
+
+/* Initializes WQ as an empty wait queue. */
+void
+waitqueue_init (struct waitqueue *wq) {
+	ASSERT (wq != NULL);
+
+	heap_init (&wq->exclusive, waiter_less, NULL);
+	heap_init (&wq->shared, waiter_less, NULL);
+	wq->seq = 0;
+}
+
+/* Puts the current thread on WQ, as an exclusive waiter if
+   EXCLUSIVE is true, without going to sleep yet.  Once on WQ, it
+   may be woken at any time, so the caller must call
+   waitqueue_sleep() next, with no sleeping in between.  This
+   lets the caller drop other locks between getting in line and
+   going to sleep.  The caller's spinlock must be held, with
+   interrupts off. */
+void
+waitqueue_prepare (struct waitqueue *wq, bool exclusive) {
+	struct thread *t = thread_current ();
+
+	ASSERT (wq != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->waitq == NULL);
+
+	spinlock_acquire (&sched_lock);
+	t->waitq = wq;
+	t->wait_exclusive = exclusive;
+	t->wait_seq = wq->seq++;
+	heap_push (exclusive ? &wq->exclusive : &wq->shared, &t->wait_elem);
+	spinlock_release (&sched_lock);
+}
+
+/* Puts the current thread, which waitqueue_prepare() put on WQ,
+   to sleep until it is woken up or the timer reaches END_TICK,
+   unless END_TICK is INT64_MAX.  Returns true if it was woken
+   up, which may have happened already, or false on timeout.
+   LOCK, the caller's spinlock, must be held with interrupts off,
+   and is held again on return. */
+bool
+waitqueue_sleep (struct waitqueue *wq, struct spinlock *lock,
+                 int64_t end_tick) {
+	struct thread *t = thread_current ();
+	bool woken;
+
+	ASSERT (wq != NULL);
+	ASSERT (spinlock_held (lock));
+
+	if (t->waitq == NULL)
+		return true;
+	thread_block_until (lock, end_tick);
+
+	/* Still on WQ means nobody woke us up: the timer did. */
+	spinlock_acquire (&sched_lock);
+	woken = t->waitq == NULL;
+	if (!woken) {
+		heap_remove (t->wait_exclusive ? &wq->exclusive : &wq->shared,
+		             &t->wait_elem);
+		t->waitq = NULL;
+	}
+	spinlock_release (&sched_lock);
+	return woken;
+}
+
+/* Waits on WQ, as an exclusive waiter if EXCLUSIVE is true.
+   Same as waitqueue_prepare() followed by waitqueue_sleep(). */
+bool
+waitqueue_wait (struct waitqueue *wq, struct spinlock *lock,
+                bool exclusive, int64_t end_tick) {
+	waitqueue_prepare (wq, exclusive);
+	return waitqueue_sleep (wq, lock, end_tick);
+}
+
+/* Pops the top waiter off HEAP, one of a wait queue's heaps, and
+   wakes it up.  sched_lock must be held. */
+static void
+waitqueue_wake_top (struct heap *heap) {
+	struct thread *t = heap_entry (heap_pop (heap), struct thread, wait_elem);
+
+	t->waitq = NULL;
+	thread_wake_locked (t);
+}
+
+/* Wakes up every non-exclusive waiter on WQ and the
+   highest-priority exclusive waiter, if any.  Returns true if an
+   exclusive waiter was woken.  Like thread_unblock(), does not
+   preempt the running thread, so it may be called from an
+   interrupt handler.  The caller's spinlock must be held, with
+   interrupts off. */
+bool
+waitqueue_wake_one (struct waitqueue *wq) {
+	bool woken;
+
+	ASSERT (wq != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	while (!heap_empty (&wq->shared))
+		waitqueue_wake_top (&wq->shared);
+	woken = !heap_empty (&wq->exclusive);
+	if (woken)
+		waitqueue_wake_top (&wq->exclusive);
+	spinlock_release (&sched_lock);
+	return woken;
+}
+
+/* Wakes up every waiter on WQ, highest priority first.  Same
+   rules as waitqueue_wake_one(). */
+void
+waitqueue_wake_all (struct waitqueue *wq) {
+	ASSERT (wq != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	while (!heap_empty (&wq->shared))
+		waitqueue_wake_top (&wq->shared);
+	while (!heap_empty (&wq->exclusive))
+		waitqueue_wake_top (&wq->exclusive);
+	spinlock_release (&sched_lock);
 }
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
@@ -81,7 +279,11 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	waitqueue_init (&sema->waiters);
+	spinlock_init (&sema->lock);
+#ifdef LOCKSTAT
+	sema->stat = NULL;
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -108,21 +310,76 @@ sema_init (struct semaphore *sema, unsigned value) {
 void
 sema_down (struct semaphore *sema) {
 	enum intr_level old_level;
+#ifdef LOCKSTAT
+	uint64_t start = rdtsc ();
+	bool contended;
+#endif
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
+#ifdef LOCKSTAT
+	contended = sema->value == 0;
+#endif
 	while (sema->value == 0) {
 		/*-- Priority donation 과제 --*/
-		// 현재 스레드를 priority 높은 순으로 waiters 리스트에 삽입
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, thread_priority_cmp, NULL);
-		// list_push_back (&sema->waiters, &thread_current ()->elem); 이건 기존꺼.
+		// waiters 힙에서 priority 높은 순(같으면 먼저 온 순)으로 깨어남
+		waitqueue_wait (&sema->waiters, &sema->lock, true, INT64_MAX);
 		/*-- Priority donation 과제 --*/
-		thread_block ();
 	}
 	sema->value--;
+	spinlock_release (&sema->lock);
 	intr_set_level (old_level);
+#ifdef LOCKSTAT
+	lock_stat_acquired (sema->stat, contended, rdtsc () - start);
+#endif
+}
+
+/* Like sema_down(), but gives up once TICKS timer ticks have
+   passed without SEMA's value becoming positive.  Returns true if
+   SEMA was decremented, false on timeout.  If TICKS <= 0, same
+   as sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+sema_down_timeout (struct semaphore *sema, int64_t ticks) {
+	enum intr_level old_level;
+	int64_t end_tick;
+	bool success = true;
+#ifdef LOCKSTAT
+	uint64_t start = rdtsc ();
+	bool contended;
+#endif
+
+	ASSERT (sema != NULL);
+	ASSERT (!intr_context ());
+
+	if (ticks <= 0)
+		return sema_try_down (sema);
+	end_tick = timer_ticks () + ticks;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
+#ifdef LOCKSTAT
+	contended = sema->value == 0;
+#endif
+	while (sema->value == 0 && success)
+		success = waitqueue_wait (&sema->waiters, &sema->lock, true, end_tick);
+
+	/* The value may have gone up just as we timed out. */
+	success = sema->value > 0;
+	if (success)
+		sema->value--;
+	spinlock_release (&sema->lock);
+	intr_set_level (old_level);
+#ifdef LOCKSTAT
+	if (success)
+		lock_stat_acquired (sema->stat, contended, rdtsc () - start);
+#endif
+	return success;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -138,6 +395,7 @@ sema_try_down (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
 	if (sema->value > 0)
 	{
 		sema->value--;
@@ -145,7 +403,12 @@ sema_try_down (struct semaphore *sema) {
 	}
 	else
 		success = false;
+	spinlock_release (&sema->lock);
 	intr_set_level (old_level);
+#ifdef LOCKSTAT
+	if (success)
+		lock_stat_acquired (sema->stat, false, 0);
+#endif
 
 	return success;
 }
@@ -161,17 +424,13 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)){
-
-	/*-- Priority donation 과제 --*/
-		/* Priority donation 과제
-		   waiters 리스트를 priority 기준으로 정렬하여 가장 높은 priority 스레드를 먼저 깨우도록 함.
-		*/	
-		list_sort(&sema->waiters, thread_priority_cmp, NULL);
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
-	}
+	spinlock_acquire (&sema->lock);
 	sema->value++;
+	/*-- Priority donation 과제 --*/
+	// waiters 힙의 top, 즉 가장 높은 priority 스레드 하나만 깨움. O(log n)
+	waitqueue_wake_one (&sema->waiters);
+	/*-- Priority donation 과제 --*/
+	spinlock_release (&sema->lock);
 
 	/*-- Priority donation 과제 --*/
 	check_and_preempt();  // 현재 running thread가 우선순위에 밀리는 상황이라면 양보할지 판단
@@ -246,6 +505,35 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	heap_init (&lock->donors, donor_less, NULL);
+	lock->hold.max_priority = -1;
+#ifdef LOCKSTAT
+	lock->stat = NULL;
+#endif
+}
+
+/* Makes the current thread the holder of LOCK, which it has just
+   downed, and lets any threads still waiting for LOCK donate to
+   it.  sched_lock must be held. */
+static void
+lock_claim (struct lock *lock) {
+	struct thread *t = thread_current ();
+
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (t->wait_lock == lock) {
+		heap_remove (&lock->donors, &t->donor_elem);
+		t->wait_lock = NULL;
+	}
+	lock->holder = t;
+
+	if (!thread_mlfqs) {
+		struct heap_elem *e = heap_top (&lock->donors);
+		lock->hold.max_priority = e != NULL
+			? heap_entry (e, struct thread, donor_elem)->priority : -1;
+		heap_push (&t->held_locks, &lock->hold.elem);
+		refresh_priority ();
+	}
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -258,30 +546,56 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	enum intr_level old_level;
+#ifdef LOCKSTAT
+	uint64_t start = rdtsc ();
+#endif
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	if (sema_try_down (&lock->semaphore)) {
+		old_level = intr_disable ();
+		spinlock_acquire (&sched_lock);
+		lock_claim (lock);
+		spinlock_release (&sched_lock);
+		intr_set_level (old_level);
+#ifdef LOCKSTAT
+		lock->acquired_tsc = rdtsc ();
+		lock_stat_acquired (lock->stat, false, 0);
+#endif
+		return;
+	}
 
 	/*-- Priority donation 과제 --*/
+	// donation 정보(holder, wait_lock, donors)는 다른 CPU도 보므로 sched_lock으로 보호
     struct thread *t = thread_current();
-    if (lock->holder != NULL) {
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+    if (!thread_mlfqs) { // 4.4BSD 스케줄러에서는 donation 없음
+        // 보유자가 잠깐 없는 순간이어도 donors에 들어가 두면, 락을 차지하는 스레드가 lock_claim()에서 기부를 이어받음
         t->wait_lock = lock;
-
-		/*-- Priority CondVar 과제 --*/
-		list_insert_ordered(&lock->holder->donations, &t->donation_elem, donation_priority_cmp, NULL);
-		/*-- Priority CondVar 과제 --*/
-
+        heap_push(&lock->donors, &t->donor_elem);
         donate_priority();
     }
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
 	/*-- Priority donation 과제 --*/
 
 	sema_down (&lock->semaphore);
 
 	/*-- Priority donation 과제 --*/
-	t->wait_lock = NULL;
-	lock->holder = thread_current();
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	lock_claim (lock);
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
 	/*-- Priority donation 과제 --*/
+#ifdef LOCKSTAT
+	lock->acquired_tsc = rdtsc ();
+	lock_stat_acquired (lock->stat, true, lock->acquired_tsc - start);
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -298,8 +612,17 @@ lock_try_acquire (struct lock *lock) {
 	ASSERT (!lock_held_by_current_thread (lock));
 
 	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
+	if (success) {
+		enum intr_level old_level = intr_disable ();
+		spinlock_acquire (&sched_lock);
+		lock_claim (lock);
+		spinlock_release (&sched_lock);
+		intr_set_level (old_level);
+#ifdef LOCKSTAT
+		lock->acquired_tsc = rdtsc ();
+		lock_stat_acquired (lock->stat, false, 0);
+#endif
+	}
 	return success;
 }
 
@@ -311,15 +634,27 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
+#ifdef LOCKSTAT
+	lock_stat_released (lock->stat, rdtsc () - lock->acquired_tsc);
+#endif
 	
 	/*-- Priority donation 과제 --*/
-    remove_with_lock(lock);
-    refresh_priority();
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	if (!thread_mlfqs) {
+		// 이 락으로 받던 기부를 heap에서 빼고, 남은 락 중 최고 기부로 우선순위 재계산. O(log n)
+		heap_remove(&thread_current()->held_locks, &lock->hold.elem);
+		refresh_priority();
+	}
+	lock->holder = NULL;
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
 	/*-- Priority donation 과제 --*/
 
-	lock->holder = NULL;
 	sema_up (&lock->semaphore);
 }
 
@@ -333,6 +668,238 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+/* Initializes RW as a reader-writer lock that nobody holds. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	spinlock_init (&rw->lock);
+	rw->readers = 0;
+	rw->writer = NULL;
+	rw->writers_waiting = 0;
+	list_init (&rw->read_waiters);
+	list_init (&rw->write_waiters);
+	heap_init (&rw->donors, donor_less, NULL);
+	rw->max_priority = -1;
+	list_init (&rw->holds);
+	rw->writer_hold.max_priority = -1;
+}
+
+/* Puts the current thread to sleep on WAITERS, one of RW's wait
+   lists, after letting it donate its priority to RW's holders if
+   it has not done so yet.  RW->lock must be held, and is held
+   again on return. */
+static void
+rwlock_wait (struct rwlock *rw, struct list *waiters) {
+	struct thread *t = thread_current ();
+
+	ASSERT (spinlock_held (&rw->lock));
+
+	if (!thread_mlfqs && t->wait_rwlock != rw) {
+		spinlock_acquire (&sched_lock);
+		t->wait_rwlock = rw;
+		heap_push (&rw->donors, &t->donor_elem);
+		donate_priority ();
+		spinlock_release (&sched_lock);
+	}
+	list_insert_ordered (waiters, &t->elem, thread_priority_cmp, NULL);
+	thread_block_locked (&rw->lock);
+}
+
+/* Wakes up the highest priority thread on WAITERS, one of RW's
+   wait lists.  RW->lock must be held. */
+static void
+rwlock_wake_one (struct list *waiters) {
+	list_sort (waiters, thread_priority_cmp, NULL);
+	thread_unblock (list_entry (list_pop_front (waiters), struct thread, elem));
+}
+
+/* Adds HOLD, which the current thread has just taken on RW, to
+   the current thread's held_locks, and brings every holder's
+   share of RW's donations up to date, since the current thread
+   no longer donates to RW.  Both RW->lock and sched_lock must be
+   held. */
+static void
+rwlock_claim (struct rwlock *rw, struct lock_hold *hold) {
+	struct thread *t = thread_current ();
+	struct heap_elem *top;
+	struct list_elem *e;
+
+	ASSERT (spinlock_held (&rw->lock));
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (t->wait_rwlock == rw) {
+		heap_remove (&rw->donors, &t->donor_elem);
+		t->wait_rwlock = NULL;
+	}
+	if (thread_mlfqs)
+		return;
+
+	top = heap_top (&rw->donors);
+	rw->max_priority = top != NULL
+		? heap_entry (top, struct thread, donor_elem)->priority : -1;
+	hold->max_priority = rw->max_priority;
+	heap_push (&t->held_locks, &hold->elem);
+	refresh_priority ();
+
+	for (e = list_begin (&rw->holds); e != list_end (&rw->holds);
+	     e = list_next (e)) {
+		struct rwlock_hold *h = list_entry (e, struct rwlock_hold, elem);
+		if (h->hold.max_priority != rw->max_priority)
+			donate_to_hold (h->thread, &h->hold, rw->max_priority);
+	}
+	if (rw->writer != NULL && rw->writer_hold.max_priority != rw->max_priority)
+		donate_to_hold (rw->writer, &rw->writer_hold, rw->max_priority);
+}
+
+/* Takes HOLD, which the current thread is giving up, out of its
+   held_locks.  sched_lock must be held. */
+static void
+rwlock_unclaim (struct lock_hold *hold) {
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (!thread_mlfqs) {
+		heap_remove (&thread_current ()->held_locks, &hold->elem);
+		refresh_priority ();
+	}
+}
+
+/* Acquires RW shared, sleeping until no thread holds it
+   exclusive and no writer is waiting for it.  The current thread
+   must not already hold RW, and may hold at most
+   RWLOCK_SHARED_MAX reader-writer locks shared at once.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_shared (struct rwlock *rw) {
+	struct thread *t = thread_current ();
+	struct rwlock_hold *h = NULL;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	for (i = 0; i < RWLOCK_SHARED_MAX; i++) {
+		ASSERT (t->shared_holds[i].rwlock != rw);
+		if (h == NULL && t->shared_holds[i].rwlock == NULL)
+			h = &t->shared_holds[i];
+	}
+	if (h == NULL)
+		PANIC ("more than %d reader-writer locks held shared",
+		       RWLOCK_SHARED_MAX);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	while (rw->writer != NULL || rw->writers_waiting > 0)
+		rwlock_wait (rw, &rw->read_waiters);
+	rw->readers++;
+
+	h->rwlock = rw;
+	h->thread = t;
+	spinlock_acquire (&sched_lock);
+	list_push_back (&rw->holds, &h->elem);
+	rwlock_claim (rw, &h->hold);
+	spinlock_release (&sched_lock);
+	spinlock_release (&rw->lock);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds shared.  The last
+   reader out wakes up a waiting writer. */
+void
+rwlock_release_shared (struct rwlock *rw) {
+	struct thread *t = thread_current ();
+	struct rwlock_hold *h = NULL;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (rw != NULL);
+
+	for (i = 0; i < RWLOCK_SHARED_MAX; i++)
+		if (t->shared_holds[i].rwlock == rw)
+			h = &t->shared_holds[i];
+	ASSERT (h != NULL);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	spinlock_acquire (&sched_lock);
+	list_remove (&h->elem);
+	rwlock_unclaim (&h->hold);
+	spinlock_release (&sched_lock);
+	h->rwlock = NULL;
+
+	if (--rw->readers == 0 && !list_empty (&rw->write_waiters))
+		rwlock_wake_one (&rw->write_waiters);
+	spinlock_release (&rw->lock);
+
+	check_and_preempt ();
+	intr_set_level (old_level);
+}
+
+/* Acquires RW exclusive, sleeping until no thread holds it.
+   While the current thread waits, no new readers get in.  The
+   current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_exclusive (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	rw->writers_waiting++;
+	while (rw->writer != NULL || rw->readers > 0)
+		rwlock_wait (rw, &rw->write_waiters);
+	rw->writers_waiting--;
+
+	spinlock_acquire (&sched_lock);
+	rw->writer = thread_current ();
+	rwlock_claim (rw, &rw->writer_hold);
+	spinlock_release (&sched_lock);
+	spinlock_release (&rw->lock);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread holds exclusive, and
+   wakes up the next writer or, if no writer wants RW, every
+   waiting reader. */
+void
+rwlock_release_exclusive (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->writer == thread_current ());
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	spinlock_acquire (&sched_lock);
+	rwlock_unclaim (&rw->writer_hold);
+	rw->writer = NULL;
+	spinlock_release (&sched_lock);
+
+	/* A woken writer may still be on its way, off the list but
+	   counted in writers_waiting.  Then readers keep waiting. */
+	if (!list_empty (&rw->write_waiters))
+		rwlock_wake_one (&rw->write_waiters);
+	else if (rw->writers_waiting == 0) {
+		list_sort (&rw->read_waiters, thread_priority_cmp, NULL);
+		while (!list_empty (&rw->read_waiters))
+			thread_unblock (list_entry (list_pop_front (&rw->read_waiters),
+			                            struct thread, elem));
+	}
+	spinlock_release (&rw->lock);
+
+	check_and_preempt ();
+	intr_set_level (old_level);
+}
+
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -341,7 +908,8 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	spinlock_init (&cond->lock);
+	waitqueue_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -367,27 +935,29 @@ cond_init (struct condition *cond) {
 // 여기서 struct condition *cond는 특정한 공유 자원과 연결된 컨디션 변수.
 void
 cond_wait (struct condition *cond, struct lock *lock) {
-	// 설명: 컨디션 변수용 세마포어 선언.
-	// 현재 스레드가 사용할 "자기 전용 이진 세마포어".
-	struct semaphore_elem waiter;
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	// 설명: 컨디션 변수용 세마포어 초기화.
-	// waiter 내부 세마포어 초기화 (초기값 0 → 다른 스레드가 up 해줄 때까지 잠듦)
-	sema_init (&waiter.semaphore, 0); 
-
-	/*-- Priority CondVar 과제 --*/
-	// list_push_back (&cond->waiters, &waiter.elem);
-	// 특정한 공유 자원(&cond)의 리스트(->waiters)에, 이 스레드의 elem을, sema_priority_cmp 순서에 의하여 추가.
-	list_insert_ordered(&cond->waiters, &waiter.elem, sema_priority_cmp, NULL);
 	/*-- Priority CondVar 과제 --*/
+	// 락을 놓기 전에 먼저 줄을 서야 그 사이의 signal을 놓치지 않음.
+	// 줄 선 뒤에 깨워지면 waitqueue_sleep()은 잠들지 않고 바로 돌아옴.
+	old_level = intr_disable ();
+	spinlock_acquire (&cond->lock);
+	waitqueue_prepare (&cond->waiters, true);
+	spinlock_release (&cond->lock);
 
 	lock_release (lock);
-	sema_down (&waiter.semaphore); // 잠드는 지점은 여기!!!! (+ 스레드가 여기서 block, 스택 메모리 유지됨)
+
+	spinlock_acquire (&cond->lock);
+	waitqueue_sleep (&cond->waiters, &cond->lock, INT64_MAX); // 잠드는 지점은 여기!!!!
+	spinlock_release (&cond->lock);
+	intr_set_level (old_level);
+	/*-- Priority CondVar 과제 --*/
+
 	lock_acquire (lock);
 }
 
@@ -400,20 +970,22 @@ cond_wait (struct condition *cond, struct lock *lock) {
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)){// 즉, 대기 중인 (잠든) 스레드가 존재한다면,
-
-		/*-- Priority CondVar 과제 --*/
-		list_sort(&cond->waiters, sema_priority_cmp, NULL); // 우선순위가 가장 높은 스레드가 들어 있는 세마포어를 찾기 위함
-		/*-- Priority CondVar 과제 --*/
-
-		sema_up (&list_entry (list_pop_front (&cond->waiters),
-					struct semaphore_elem, elem)->semaphore);
-	}
+	/*-- Priority CondVar 과제 --*/
+	// 대기 중인 스레드 중 우선순위가 가장 높은 스레드 하나만 깨움.
+	old_level = intr_disable ();
+	spinlock_acquire (&cond->lock);
+	waitqueue_wake_one (&cond->waiters);
+	spinlock_release (&cond->lock);
+	check_and_preempt ();
+	intr_set_level (old_level);
+	/*-- Priority CondVar 과제 --*/
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -424,12 +996,20 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
    interrupt handler. */
 // 이러한 것들은 사용자 코드(혹은 OS 내부의 논리 코드)가 직접 호출해야 함.
 void
-cond_broadcast (struct condition *cond, struct lock *lock) {
+cond_broadcast (struct condition *cond, struct lock *lock UNUSED) {
+	enum intr_level old_level;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (lock_held_by_current_thread (lock));
 
-	while (!list_empty (&cond->waiters))
-		cond_signal (cond, lock);
+	old_level = intr_disable ();
+	spinlock_acquire (&cond->lock);
+	waitqueue_wake_all (&cond->waiters);
+	spinlock_release (&cond->lock);
+	check_and_preempt ();
+	intr_set_level (old_level);
 }
 
 /* `cond_signal` 관련 예시 코드:
@@ -452,4 +1032,122 @@ void consumer(void) {
     consume_item();
     lock_release(&lock);
 }
-*/
\ No newline at end of file
+*/
+
+#ifdef LOCKSTAT
+/* Number of lines printed by lock_print_stats(). */
+#define LOCK_STAT_TOP 10
+
+/* Most lock_stats lock_print_stats() can sort. */
+#define LOCK_STAT_MAX 256
+
+/* Every lock_stat in use, most recently registered first. */
+static struct lock_stat *lock_stats;
+
+/* Like spinlock_init(), but keeps statistics in STAT. */
+void
+spinlock_init_stat (struct spinlock *lock, struct lock_stat *stat) {
+	spinlock_init (lock);
+	lock->stat = stat;
+	lock_stat_register (stat);
+}
+
+/* Like sema_init(), but keeps statistics in STAT. */
+void
+sema_init_stat (struct semaphore *sema, unsigned value,
+                struct lock_stat *stat) {
+	sema_init (sema, value);
+	sema->stat = stat;
+	lock_stat_register (stat);
+}
+
+/* Like lock_init(), but keeps statistics in STAT. */
+void
+lock_init_stat (struct lock *lock, struct lock_stat *stat) {
+	lock_init (lock);
+	lock->stat = stat;
+	lock_stat_register (stat);
+}
+
+/* Adds STAT to lock_stats the first time it is used.  Takes no
+   lock, because the first spinlock is initialized before there
+   is anything to protect lock_stats with. */
+static void
+lock_stat_register (struct lock_stat *stat) {
+	if (__atomic_exchange_n (&stat->registered, 1, __ATOMIC_RELAXED))
+		return;
+
+	stat->next = __atomic_load_n (&lock_stats, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n (&lock_stats, &stat->next, stat, true,
+	                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		continue;
+}
+
+/* Records an acquisition in STAT, if it is nonnull, that took
+   WAIT cycles and was CONTENDED or not.  STAT is shared by every
+   lock initialized at one place, so it is updated atomically. */
+static void
+lock_stat_acquired (struct lock_stat *stat, bool contended, uint64_t wait) {
+	uint64_t max;
+
+	if (stat == NULL)
+		return;
+
+	__atomic_fetch_add (&stat->acquisitions, 1, __ATOMIC_RELAXED);
+	if (!contended)
+		return;
+	__atomic_fetch_add (&stat->contended, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add (&stat->wait_cycles, wait, __ATOMIC_RELAXED);
+	max = __atomic_load_n (&stat->wait_max, __ATOMIC_RELAXED);
+	while (wait > max
+	       && !__atomic_compare_exchange_n (&stat->wait_max, &max, wait, true,
+	                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		continue;
+}
+
+/* Records in STAT, if it is nonnull, that a lock was held for
+   HOLD cycles. */
+static void
+lock_stat_released (struct lock_stat *stat, uint64_t hold) {
+	if (stat != NULL)
+		__atomic_fetch_add (&stat->hold_cycles, hold, __ATOMIC_RELAXED);
+}
+
+/* Prints the LOCK_STAT_TOP lock_stats with the most time spent
+   waiting. */
+void
+lock_print_stats (void) {
+	static struct lock_stat *sorted[LOCK_STAT_MAX];
+	struct lock_stat *stat;
+	int cnt = 0, total = 0;
+	int i, j;
+
+	/* Insertion sort on wait_cycles, most first. */
+	for (stat = lock_stats; stat != NULL; stat = stat->next) {
+		total++;
+		if (stat->acquisitions == 0)
+			continue;
+		if (cnt < LOCK_STAT_MAX)
+			cnt++;
+		else if (stat->wait_cycles <= sorted[cnt - 1]->wait_cycles)
+			continue;
+		for (j = cnt - 1; j > 0 && sorted[j - 1]->wait_cycles < stat->wait_cycles; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = stat;
+	}
+
+	printf ("Locks: %d initialization sites, %d used, top %d by time waited:\n",
+			total, cnt, cnt < LOCK_STAT_TOP ? cnt : LOCK_STAT_TOP);
+	printf ("  %10s %10s %10s %10s %10s  %s\n", "acquired", "contended",
+			"wait us", "max us", "held us", "lock");
+	for (i = 0; i < cnt && i < LOCK_STAT_TOP; i++) {
+		stat = sorted[i];
+		printf ("  %10llu %10llu %10lld %10lld %10lld  %s (%s:%d)\n",
+				stat->acquisitions, stat->contended,
+				timer_cycles_to_us (stat->wait_cycles),
+				timer_cycles_to_us (stat->wait_max),
+				timer_cycles_to_us (stat->hold_cycles),
+				stat->name, stat->file, stat->line);
+	}
+}
+#endif /* LOCKSTAT */
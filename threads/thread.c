@@ -8,10 +8,15 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
+#include "userprog/fpu.h"
 #include "userprog/process.h"
 #endif
 
@@ -24,12 +29,22 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Each CPU has its own run queue of processes in THREAD_READY
+   state, that is, processes that are ready to run but not
+   actually running, in struct cpu.  There is one FIFO list per
+   priority level, and bit P of ready_mask is set iff
+   ready_queues[P] is nonempty, so the highest-priority ready
+   thread is found with a single find-first-set instead of an
+   ordered insert.  Each CPU also has its own idle thread.
+
+   sched_lock protects all of the run queues, the status,
+   priority and donation state of every thread, the sleep heap,
+   the 4.4BSD scheduler's state and destruction_req.  It is only
+   acquired with interrupts off.  A thread that calls schedule()
+   holds it across the switch, and the thread switched to
+   releases it, so that no other CPU can pick up the old thread
+   before it is completely off its stack. */
+struct spinlock sched_lock;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -40,35 +55,150 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+/* A cache of free objects of one type, each PAGE_CNT pages long.
+
+   Creating a thread takes a thread page and an fd table.  Getting
+   them from palloc means taking the pool lock, scanning the pool
+   bitmap and zeroing 12 kB, and then the pages go straight back
+   when the thread dies.  Instead, dead threads' pages are kept
+   here, up to CACHE_MAX of each type, for the next thread_create()
+   to pick up.  A recycled thread page is not cleared, since
+   init_thread() clears the struct thread itself and nothing else
+   in the page needs to be zero.  A recycled fd table is already
+   all null pointers, because process_exit() closes every file in
+   it. */
+struct object_cache {
+	struct spinlock lock;       /* Protects the members below. */
+	void *free;                 /* Free objects, linked through
+	                               their first word. */
+	size_t free_cnt;            /* Number of free objects. */
+	size_t page_cnt;            /* Pages per object. */
+	enum palloc_flags flags;    /* For allocating new objects. */
+};
+
+#define CACHE_MAX 32            /* Free objects kept per cache. */
+
+static struct object_cache thread_cache;   /* Thread pages. */
+static struct object_cache fdt_cache;      /* fd tables. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+#define BALANCE_INTERVAL 16     /* # of timer ticks between balancing. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the proportional-share scheduler.
+   Controlled by kernel command-line option "-fair". */
+bool thread_fair;
+
 /* sleep_lock for sleeping threads. */
 // static struct lock sleep_lock;
 
-/* List of sleeping threads. */
-static struct list sleep_list;
+/* Sleeping threads, as a min-heap on wakeup_tick.  The earliest
+   wakeup is always at the top, so a timer tick with nothing due
+   costs a single comparison. */
+static struct heap sleep_heap;
+
+/* Interrupt-off time spent on sleep_heap. */
+static struct sleep_stats sleep_stats;
+
+/* 4.4BSD scheduler state.  A thread with recent_cpu and nice both
+   zero has priority PRI_MAX and is left alone by the once-per-second
+   decay, so only threads for which either is nonzero are kept on
+   mlfqs_threads.  Threads whose recent_cpu has changed since their
+   priority was last computed are kept on mlfqs_dirty.  This way no
+   timer tick has to visit every thread in the system. */
+static fixed_t load_avg;                /* System load average. */
+static struct list mlfqs_threads;       /* Threads with nonzero state. */
+static struct list mlfqs_dirty;         /* Threads needing new priority. */
+
+/* Proportional-share scheduler.  Each CPU keeps its ready threads
+   in a min-heap on virtual runtime, and the thread at the top,
+   the one that has had the least CPU time relative to its share,
+   runs next.  A thread's share is proportional to a weight
+   derived from its priority, FAIR_WEIGHT_STEP times larger for
+   each priority level, so a thread at PRI_DEFAULT + 7 gets about
+   twice the CPU time of one at PRI_DEFAULT, but no thread is
+   ever starved.  Virtual runtime is charged by the timer tick, at
+   FAIR_WEIGHT0 units per tick for a thread of weight
+   FAIR_WEIGHT0 and inversely to the weight otherwise.
+
+   Instead of a fixed TIME_SLICE, a thread gets its share of
+   FAIR_LATENCY, so that every ready thread on a CPU runs within
+   about that many ticks. */
+#define FAIR_WEIGHT0 1024       /* Weight at PRI_DEFAULT. */
+#define FAIR_WEIGHT_STEP_NUM 11 /* Weight ratio between adjacent */
+#define FAIR_WEIGHT_STEP_DEN 10 /*   priority levels, 1.1. */
+#define FAIR_LATENCY 12         /* Target latency, in timer ticks. */
+#define FAIR_WAKEUP_GRAN FAIR_WEIGHT0 /* Virtual runtime lead needed
+                                   to preempt, one tick at weight 0. */
+#define FAIR_SLEEPER_CREDIT (FAIR_LATENCY / 2 * FAIR_WEIGHT0)
+                                /* Most virtual runtime a waking
+                                   thread can be behind. */
+static uint32_t fair_weights[PRI_MAX + 1];  /* Weight for each priority. */
+
+/* Deadline class.  A thread that calls thread_set_deadline()
+   asks for RUNTIME ticks of CPU time in every PERIOD ticks.  It is
+   admitted only if the total utilization, RUNTIME / PERIOD, of
+   the deadline threads on its CPU stays at most 1, and from then
+   on it stays on that CPU and runs ahead of all the threads in
+   the priority or proportional-share classes, earliest absolute
+   deadline first.
+
+   Each deadline thread is a constant bandwidth server.  The
+   timer tick charges the running thread's budget, and a thread
+   that uses up its budget is throttled until its deadline, when
+   it gets a new budget and a deadline one period later.  A
+   thread that overruns its budget thus only delays itself, and
+   as long as the admission test holds, every thread gets its
+   budget before each of its deadlines, give or take a tick. */
+#define DL_UTIL_ONE (1 << 20)   /* Utilization of a CPU-bound thread. */
 
 
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
+static void init_cpu (struct cpu *, int id);
+static struct cpu *least_loaded_cpu (void);
+static int cpu_load (const struct cpu *);
+static struct cpu *busiest_cpu (const struct cpu *);
+static struct thread *steal_thread (struct cpu *from, struct cpu *to);
+static void balance (struct cpu *);
+static void unblock_locked (struct thread *);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (const struct cpu *);
+static bool ready_queue_preempts (const struct cpu *, const struct thread *);
+static bool thread_preempts (const struct thread *, const struct thread *);
+static bool fair_vruntime_less (const struct heap_elem *,
+                                const struct heap_elem *, void *aux);
+static void fair_init (void);
+static void fair_place (struct thread *, struct cpu *);
+static void fair_tick (struct cpu *, struct thread *);
+static unsigned fair_time_slice (const struct cpu *, const struct thread *);
+static bool dl_deadline_less (const struct heap_elem *,
+                              const struct heap_elem *, void *aux);
+static bool dl_runnable (const struct thread *);
+static uint64_t dl_util (const struct thread *);
+static void dl_wakeup (struct thread *, int64_t now);
+static bool dl_tick (struct cpu *, struct thread *);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static void cache_init (struct object_cache *, size_t page_cnt,
+                        enum palloc_flags);
+static void *cache_get (struct object_cache *);
+static void cache_put (struct object_cache *, void *);
+static int mlfqs_priority (const struct thread *);
+static void mlfqs_init_thread (struct thread *);
+static void mlfqs_exit_thread (struct thread *);
+static void mlfqs_tick (struct thread *);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -86,11 +216,12 @@ static tid_t allocate_tid (void);
 // setup temporal gdt first.
 static uint64_t gdt[3] = { 0, 0x00af9a000000ffff, 0x00cf92000000ffff };
 
-/* Compares the wakeup_tick of two threads A and B.
+/* Compares the wakeup_tick of two sleeping threads A and B.
    A가 작으면 true, B가 작으면 false. */
-bool thread_wakeup_tick_cmp(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	const struct thread *thread_a = list_entry(a, struct thread, elem);
-	const struct thread *thread_b = list_entry(b, struct thread, elem);
+static bool
+thread_wakeup_tick_less (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED) {
+	const struct thread *thread_a = heap_entry(a, struct thread, sleep_elem);
+	const struct thread *thread_b = heap_entry(b, struct thread, sleep_elem);
 	return thread_a->wakeup_tick < thread_b->wakeup_tick;
 }
 
@@ -133,18 +264,95 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
+	spinlock_init (&sched_lock);
 	lock_init (&tid_lock);
-	list_init (&ready_list);
+	init_cpu (&cpus[0], 0);
 	list_init (&destruction_req);
-	list_init (&sleep_list); /** Alarm Clock 과제 */
+	cache_init (&thread_cache, 1, 0);
+	cache_init (&fdt_cache, FDT_PAGES, PAL_ZERO);
+	list_init (&mlfqs_threads);
+	list_init (&mlfqs_dirty);
+	fair_init ();
+	heap_init (&sleep_heap, thread_wakeup_tick_less, NULL); /** Alarm Clock 과제 */
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
+	if (thread_mlfqs)
+		initial_thread->priority = mlfqs_priority (initial_thread);
 	initial_thread->status = THREAD_RUNNING;
+	initial_thread->acct_tsc = rdtsc ();
+	initial_thread->cpu = &cpus[0];
+	cpus[0].curr = initial_thread;
+	cpus[0].started = true;
+	cpu_cnt = 1;
 	initial_thread->tid = allocate_tid ();
 }
 
+/* Initializes the scheduler state of CPU C, whose index in cpus[]
+   is ID. */
+static void
+init_cpu (struct cpu *c, int id) {
+	c->id = id;
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+		list_init (&c->ready_queues[pri]);
+	c->ready_mask = 0;
+	c->ready_cnt = 0;
+	heap_init (&c->fair_queue, fair_vruntime_less, NULL);
+	c->fair_weight = 0;
+	c->min_vruntime = 0;
+	heap_init (&c->dl_queue, dl_deadline_less, NULL);
+	heap_init (&c->dl_throttled, dl_deadline_less, NULL);
+	c->dl_cnt = 0;
+	c->dl_util = 0;
+	c->time_slice = TIME_SLICE;
+	c->idle_steals = c->balance_pulls = c->migrations_out = 0;
+}
+
+/* Prepares application processor C to join the scheduler: sets
+   up its run queue and creates its idle thread, which starts out
+   as the code that boots C, and returns the top of the idle
+   thread's stack for C to boot on.  Returns a null pointer if
+   memory is exhausted.
+
+   C's id must already be set.  The caller may free the page at
+   C->idle_thread if C never starts.  Since the caller cannot know
+   in advance how many CPUs will start, these idle threads do not
+   use up tids; they all have tid 0. */
+void *
+thread_init_ap (struct cpu *c) {
+	struct thread *t;
+	char name[16];
+
+	t = palloc_get_page (PAL_ZERO);
+	if (t == NULL)
+		return NULL;
+
+	snprintf (name, sizeof name, "idle%d", c->id);
+	init_thread (t, name, PRI_MIN);
+	t->status = THREAD_RUNNING;
+	t->cpu = c;
+	init_cpu (c, c->id);
+	c->idle_thread = c->curr = t;
+	return (uint8_t *) t + PGSIZE;
+}
+
+/* Turns the code that booted the running application processor
+   into its idle thread and starts scheduling on it.  Called
+   with interrupts off. */
+void
+thread_start_ap (void) {
+	struct cpu *c = this_cpu ();
+	struct thread *t = running_thread ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t == c->idle_thread);
+
+	t->acct_tsc = rdtsc ();
+	c->started = true;
+	idle_loop ();
+}
+
 /* Starts preemptive thread scheduling by enabling interrupts.
    Also creates the idle thread. */
 void
@@ -162,31 +370,140 @@ thread_start (void) {
 }
 
 /* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+   Thus, this function runs in an external interrupt context,
+   except when the idle thread catches up on ticks that passed
+   while the timer was in tickless mode. */
 void
 thread_tick (void) {
+	struct cpu *c = this_cpu ();
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
+	if (t == c->idle_thread)
+		c->idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
-		user_ticks++;
+		c->user_ticks++;
 #endif
 	else
-		kernel_ticks++;
+		c->kernel_ticks++;
+
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+	else if (thread_fair && t != c->idle_thread)
+		fair_tick (c, t);
+	if (c->dl_util != 0 && dl_tick (c, t))
+		intr_yield_on_return ();
+
+	/* Even out the run queues.  An idle CPU looks for work on
+	   every tick, a busy one only every BALANCE_INTERVAL ticks. */
+	if (cpu_cnt > 1
+			&& (t == c->idle_thread || ++c->balance_ticks >= BALANCE_INTERVAL)) {
+		c->balance_ticks = 0;
+		balance (c);
+	}
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	/* Enforce preemption.  The idle thread gives up the CPU by
+	   itself as soon as there is something else to run. */
+	if (++c->thread_ticks >= c->time_slice && t != c->idle_thread)
 		intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics, summed over all CPUs, and then per
+   CPU if there is more than one. */
 void
 thread_print_stats (void) {
+	long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+	int i;
+
+	for (i = 0; i < cpu_cnt; i++) {
+		idle_ticks += cpus[i].idle_ticks;
+		kernel_ticks += cpus[i].kernel_ticks;
+		user_ticks += cpus[i].user_ticks;
+	}
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	if (cpu_cnt > 1)
+		for (i = 0; i < cpu_cnt; i++) {
+			printf ("  CPU %d: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
+					i, cpus[i].idle_ticks, cpus[i].kernel_ticks, cpus[i].user_ticks);
+			printf ("         %lld idle steals, %lld balancer pulls, "
+					"%lld migrated away\n",
+					cpus[i].idle_steals, cpus[i].balance_pulls,
+					cpus[i].migrations_out);
+		}
+}
+
+/* Charges the running thread for the time since it was last
+   charged as user time.  Called on every entry into the kernel
+   from user mode. */
+void
+thread_charge_user (void) {
+	enum intr_level old_level = intr_disable ();
+	struct thread *t = thread_current ();
+	uint64_t now = rdtsc ();
+
+	t->usage.user_cycles += now - t->acct_tsc;
+	t->acct_tsc = now;
+	intr_set_level (old_level);
+}
+
+/* Charges the running thread for the time since it was last
+   charged as kernel time.  Called on every return to user
+   mode.  Context switches charge kernel time too, since they
+   always happen in the kernel. */
+void
+thread_charge_kernel (void) {
+	enum intr_level old_level = intr_disable ();
+	struct thread *t = thread_current ();
+	uint64_t now = rdtsc ();
+
+	t->usage.kernel_cycles += now - t->acct_tsc;
+	t->acct_tsc = now;
+	intr_set_level (old_level);
+}
+
+/* Adds the usage of CHILD, which has exited and been waited
+   for, and of the children it waited for, to the running
+   thread's child_usage. */
+void
+thread_reap_usage (struct thread *child) {
+	struct thread_usage *sum = &thread_current ()->child_usage;
+	const struct thread_usage *u[2] = {&child->usage, &child->child_usage};
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		sum->user_cycles += u[i]->user_cycles;
+		sum->kernel_cycles += u[i]->kernel_cycles;
+		sum->nvcsw += u[i]->nvcsw;
+		sum->nivcsw += u[i]->nivcsw;
+		sum->faults += u[i]->faults;
+	}
+}
+
+/* Stores the usage of the running thread in *USAGE if WHO is
+   RUSAGE_SELF, or of the children it has waited for if WHO is
+   RUSAGE_CHILDREN.  Returns 0 if successful, -1 if WHO is
+   neither. */
+int
+thread_get_rusage (int who, struct rusage *usage) {
+	struct thread *t = thread_current ();
+	const struct thread_usage *u;
+
+	if (who == RUSAGE_SELF) {
+		thread_charge_kernel ();
+		u = &t->usage;
+	} else if (who == RUSAGE_CHILDREN)
+		u = &t->child_usage;
+	else
+		return -1;
+
+	usage->utime = timer_cycles_to_us (u->user_cycles);
+	usage->stime = timer_cycles_to_us (u->kernel_cycles);
+	usage->nvcsw = u->nvcsw;
+	usage->nivcsw = u->nivcsw;
+	usage->faults = u->faults;
+	return 0;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -206,19 +523,37 @@ thread_print_stats (void) {
    Priority scheduling is the goal of Problem 1-3. */
 tid_t
 thread_create (const char *name, int priority, thread_func *function, void *aux) {
+	return thread_create_on (NULL, name, priority, function, aux);
+}
+
+/* Like thread_create(), but puts the new thread on CPU C's run
+   queue instead of the least loaded CPU's, or behaves exactly
+   like thread_create() if C is null.  The balancer may still move
+   the thread elsewhere later. */
+tid_t
+thread_create_on (struct cpu *c, const char *name, int priority,
+                  thread_func *function, void *aux) {
 	struct thread *t;
+	struct file **fd_table;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = cache_get (&thread_cache);
 	if (t == NULL)
 		return TID_ERROR;
+	fd_table = cache_get (&fdt_cache);
+	if (fd_table == NULL) {
+		cache_put (&thread_cache, t);
+		return TID_ERROR;
+	}
 
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+	if (thread_mlfqs)
+		mlfqs_init_thread (t);
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -233,18 +568,29 @@ thread_create (const char *name, int priority, thread_func *function, void *aux)
 	
 	// project 2. user programs ~
 	list_push_back(&thread_current()->child_list, &t->child_elem); // 현재 스레드의 자식으로 추가
-	t->fd_table = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
-	if (t->fd_table == NULL)
-		return TID_ERROR;
+	t->fd_table = fd_table; // 위에서 fdt_cache로부터 미리 할당. 실패 시 스레드 페이지도 돌려줌
 	// ~ project 2. user programs
 
 	/* Add to run queue. */
+	t->cpu = c;
 	thread_unblock (t);
 	check_and_preempt();// project 2.
 
 	return tid;
 }
 
+/* Returns FD_TABLE, which thread_create() gave to the running
+   thread, to the cache of fd tables.  For a thread that is going
+   to share another thread's fd table instead.  FD_TABLE must be
+   empty. */
+void
+thread_put_fd_table (struct file **fd_table) {
+	ASSERT (fd_table == thread_current ()->fd_table);
+
+	thread_current ()->fd_table = NULL;
+	cache_put (&fdt_cache, fd_table);
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -255,8 +601,86 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	trace (TRACE_BLOCK, thread_current ()->tid, 0);
+	thread_current ()->status = THREAD_BLOCKED;
+	schedule ();
+	spinlock_release (&sched_lock);
+}
+
+/* Like thread_block(), but atomically releases LOCK, which the
+   caller holds, as the current thread goes to sleep, and
+   reacquires it on wakeup.  A thread that finds the current
+   thread on a wait list protected by LOCK cannot wake it up
+   before it is blocked, even from another CPU.
+
+   Interrupts must be off. */
+void
+thread_block_locked (struct spinlock *lock) {
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (spinlock_held (lock));
+
+	spinlock_acquire (&sched_lock);
+	spinlock_release (lock);
+	trace (TRACE_BLOCK, thread_current ()->tid, 0);
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
+	spinlock_release (&sched_lock);
+	spinlock_acquire (lock);
+}
+
+/* Like thread_block_locked(), but the timer also wakes up the
+   current thread once it reaches END_TICK, unless END_TICK is
+   INT64_MAX.  The thread must be woken up early with
+   thread_wake(), not thread_unblock(), since the timer may beat
+   it to it.  Interrupts must be off. */
+void
+thread_block_until (struct spinlock *lock, int64_t end_tick) {
+	struct thread *cur = thread_current ();
+
+	ASSERT (!intr_context ());
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (spinlock_held (lock));
+
+	spinlock_acquire (&sched_lock);
+	spinlock_release (lock);
+	cur->timed_block = true;
+	cur->wakeup_tick = end_tick;
+	if (end_tick != INT64_MAX) {
+		heap_push (&sleep_heap, &cur->sleep_elem);
+		trace (TRACE_SLEEP, cur->tid, end_tick);
+	} else
+		trace (TRACE_BLOCK, cur->tid, 0);
+	cur->status = THREAD_BLOCKED;
+	schedule ();
+	spinlock_release (&sched_lock);
+	spinlock_acquire (lock);
+}
+
+/* Wakes up T, which went to sleep in thread_block_until(),
+   unless the timer has already woken it up.  Like
+   thread_unblock(), does not preempt the running thread. */
+void
+thread_wake (struct thread *t) {
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	thread_wake_locked (t);
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+}
+
+/* thread_wake() with sched_lock held. */
+void
+thread_wake_locked (struct thread *t) {
+	ASSERT (is_thread (t));
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (t->timed_block)
+		unblock_locked (t);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -266,7 +690,9 @@ thread_block (void) {
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  It does ask another CPU to reschedule if T
+   goes on that CPU's run queue and should run there right
+   away. */
 void
 thread_unblock (struct thread *t) {
 	enum intr_level old_level;
@@ -274,13 +700,178 @@ thread_unblock (struct thread *t) {
 	ASSERT (is_thread (t));
 
 	old_level = intr_disable ();
-	ASSERT (t->status == THREAD_BLOCKED);
+	spinlock_acquire (&sched_lock);
+	unblock_locked (t);
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+}
 
-	//list_push_back (&ready_list, &t->elem);
-  	list_insert_ordered(&ready_list, &t->elem, thread_priority_cmp, NULL);
+/* thread_unblock() with sched_lock held.  A thread that has
+   never run goes to the least loaded CPU, unless it was created
+   with thread_create_on(), and any other thread goes back to the
+   CPU it last ran on. */
+static void
+unblock_locked (struct thread *t) {
+	struct cpu *c;
 
+	ASSERT (spinlock_held (&sched_lock));
+	ASSERT (t->status == THREAD_BLOCKED);
+
+	if (t->timed_block) {
+		if (t->wakeup_tick != INT64_MAX)
+			heap_remove (&sleep_heap, &t->sleep_elem);
+		t->timed_block = false;
+	}
+	if (t->cpu == NULL)
+		t->cpu = least_loaded_cpu ();
+	c = t->cpu;
+
+	if (thread_fair)
+		fair_place (t, c);
+	if (t->dl_period != 0)
+		dl_wakeup (t, timer_ticks ());
+	ready_queue_push (t);
 	t->status = THREAD_READY;
-	intr_set_level (old_level);
+	trace (TRACE_WAKEUP, t->tid, c->id);
+
+	if (c != this_cpu ()
+			&& (c->curr == c->idle_thread || thread_preempts (t, c->curr)))
+		smp_reschedule (c);
+}
+
+/* Returns the CPU with the fewest ready and running threads,
+   preferring the current CPU on a tie.  sched_lock must be
+   held. */
+static struct cpu *
+least_loaded_cpu (void) {
+	struct cpu *best = this_cpu ();
+	int best_load = cpu_load (best);
+	int i;
+
+	ASSERT (spinlock_held (&sched_lock));
+
+	for (i = 0; i < cpu_cnt; i++) {
+		struct cpu *c = &cpus[i];
+		int load = cpu_load (c);
+
+		if (load < best_load) {
+			best = c;
+			best_load = load;
+		}
+	}
+	return best;
+}
+
+/* Returns the number of threads ready or running on CPU C. */
+static int
+cpu_load (const struct cpu *c) {
+	return c->ready_cnt + c->dl_cnt + (c->curr != c->idle_thread);
+}
+
+/* Returns the CPU other than SELF with the most ready and
+   running threads that has at least one thread in its run queue,
+   or a null pointer if there is no such CPU.  Deadline threads
+   never move, so only the priority or proportional-share run
+   queue counts.  sched_lock must be
+   held. */
+static struct cpu *
+busiest_cpu (const struct cpu *self) {
+	struct cpu *busiest = NULL;
+	int busiest_load = 0;
+	int i;
+
+	ASSERT (spinlock_held (&sched_lock));
+
+	for (i = 0; i < cpu_cnt; i++) {
+		struct cpu *c = &cpus[i];
+		int load = cpu_load (c);
+
+		if (c != self && c->ready_cnt > 0 && load > busiest_load) {
+			busiest = c;
+			busiest_load = load;
+		}
+	}
+	return busiest;
+}
+
+/* Moves a ready thread from CPU FROM's run queue to CPU TO's and
+   returns it.  FROM's run queue must not be empty.
+
+   The thread taken is one of the highest priority on FROM, that
+   is, one that FROM would have run next.  Priorities here are
+   effective priorities, so a thread lifted by a donation is
+   stolen before the threads it now outranks.  Among threads of
+   the same priority, the first one holding a lock that others
+   are waiting for goes first, since its donors cannot run until
+   it does.  sched_lock must be held. */
+static struct thread *
+steal_thread (struct cpu *from, struct cpu *to) {
+	struct list *queue;
+	struct list_elem *e;
+	struct thread *t;
+
+	ASSERT (spinlock_held (&sched_lock));
+	ASSERT (from != to);
+	ASSERT (from->ready_cnt > 0);
+
+	if (thread_fair) {
+		/* Take the thread FROM would run next, keeping its lag
+		   behind FROM's minimum virtual runtime on TO. */
+		int64_t lag;
+
+		t = heap_entry (heap_top (&from->fair_queue), struct thread, fair_elem);
+		ready_queue_remove (t);
+		lag = (int64_t) (t->vruntime - from->min_vruntime);
+		t->vruntime = lag >= 0 || to->min_vruntime >= (uint64_t) -lag
+			? to->min_vruntime + lag : 0;
+		t->cpu = to;
+		ready_queue_push (t);
+		from->migrations_out++;
+		return t;
+	}
+
+	queue = &from->ready_queues[ready_queue_max_priority (from)];
+	t = list_entry (list_front (queue), struct thread, elem);
+	for (e = list_begin (queue); e != list_end (queue); e = list_next (e)) {
+		struct thread *donee = list_entry (e, struct thread, elem);
+		if (!heap_empty (&donee->held_locks)
+				&& heap_entry (heap_top (&donee->held_locks), struct lock_hold,
+				               elem)->max_priority >= PRI_MIN) {
+			t = donee;
+			break;
+		}
+	}
+
+	ready_queue_remove (t);
+	t->cpu = to;
+	ready_queue_push (t);
+	from->migrations_out++;
+	return t;
+}
+
+/* Called from thread_tick() on CPU C.  If C is idle, or has at
+   least two threads fewer than the busiest CPU, pulls a thread
+   over from that CPU, and preempts C's running thread if the
+   newcomer should run first. */
+static void
+balance (struct cpu *c) {
+	struct cpu *busiest;
+	struct thread *t = NULL;
+	bool preempt = false;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	busiest = busiest_cpu (c);
+	if (busiest != NULL && cpu_load (busiest) - cpu_load (c) >= 2) {
+		t = steal_thread (busiest, c);
+		c->balance_pulls++;
+		preempt = c->curr == c->idle_thread || thread_preempts (t, c->curr);
+	}
+	spinlock_release (&sched_lock);
+
+	if (preempt)
+		intr_yield_on_return ();
 }
 
 /* Returns the name of the running thread. */
@@ -326,15 +917,16 @@ thread_exit (void) {
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	spinlock_acquire (&sched_lock);
+	if (thread_mlfqs)
+		mlfqs_exit_thread (thread_current ());
+	this_cpu ()->dl_util -= dl_util (thread_current ());
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
-// Priority scheduling의 구현을 위해서는,
-// 현재 실행 중인 스레드가 idle_thread가 아니면, 
-// ready_list에 다시 삽입할 때 우선순위에 따라 정렬되도록 해야 함.
 void
 thread_yield (void) {
 	struct thread *curr = thread_current ();
@@ -343,57 +935,155 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		// list_push_back (&ready_list, &curr->elem);
-    	list_insert_ordered(&ready_list, &curr->elem, thread_priority_cmp, NULL);
+	spinlock_acquire (&sched_lock);
+	if (curr != this_cpu ()->idle_thread)
+		ready_queue_push (curr);
 
 	do_schedule (THREAD_READY);
+	spinlock_release (&sched_lock);
 	intr_set_level (old_level);
 }
 
 
+/* Adds CYCLES to the running totals in *CNT, *TOTAL and *MAX. */
+static void
+sleep_stats_add (uint64_t *cnt, uint64_t *total, uint64_t *max, uint64_t cycles) {
+	(*cnt)++;
+	*total += cycles;
+	if (*max < cycles)
+		*max = cycles;
+}
+
+/* Blocks the running thread until the timer reaches END_TICK. */
 void thread_sleep(int64_t end_tick){
     enum intr_level old_level;
     struct thread *cur = thread_current();
+    uint64_t start;
 
     ASSERT(!intr_context());
-    ASSERT(cur != idle_thread);
 
     old_level = intr_disable();
+    ASSERT(cur != this_cpu()->idle_thread);
+    spinlock_acquire(&sched_lock);
+    start = rdtsc();
     cur->wakeup_tick = end_tick; // 쓰레드에 종료틱 설정
+    heap_push(&sleep_heap, &cur->sleep_elem); // wakeup_tick 기준 min-heap에 삽입
+    sleep_stats_add(&sleep_stats.insert_cnt, &sleep_stats.insert_cycles,
+                    &sleep_stats.insert_max, rdtsc() - start);
 
-    // lock_acquire(&sleep_lock); 
-    list_insert_ordered(&sleep_list, &cur->elem, thread_wakeup_tick_cmp, NULL); // 슬립리스트에 종료틱 오름차순으로 삽입
-    // lock_release(&sleep_lock);
-
-    thread_block(); // 현재 쓰레드 블록
+    trace(TRACE_SLEEP, cur->tid, end_tick);
+    cur->status = THREAD_BLOCKED; // 현재 쓰레드 블록 (sched_lock을 쥔 채로)
+    schedule();
+    spinlock_release(&sched_lock);
 
     intr_set_level(old_level);
 }
 
-
-void thread_check_sleep_list(){
+/* Wakes up every sleeping thread whose wakeup_tick has come.
+   Called by the timer interrupt handler at each timer tick. */
+void thread_check_sleep_list(void){
     enum intr_level old_level;
-    struct thread *t;
+    int64_t ticks;
+    uint64_t start;
+    bool woken = false;
+
     old_level = intr_disable();
-    int64_t ticks = timer_ticks();
-	
-    while (!list_empty(&sleep_list)) { // 슬립 리스트에서 꺠울 쓰레드 탐색
-        t = list_entry(list_front(&sleep_list), struct thread, elem); // 슬립 리스트 맨 앞 쓰레드 조회
-        if (t->wakeup_tick > ticks) { // 쓰레드가 현재 글로벌 틱보다 크다면 탐색 종료
+    ticks = timer_ticks();
+    spinlock_acquire(&sched_lock);
+    start = rdtsc();
+
+    while (!heap_empty(&sleep_heap)) { // 힙의 top이 가장 먼저 깨어날 쓰레드
+        struct thread *t = heap_entry(heap_top(&sleep_heap), struct thread, sleep_elem);
+        if (t->wakeup_tick > ticks) // 아직 깨울 시간이 아니면 나머지도 전부 아님
             break;
-        }
-        list_pop_front(&sleep_list); // 쓰레드가 현재 글로벌 틱보다 작거나 같다면 슬립 리스트에서 제거
-        thread_unblock(t); // 해당 쓰레드 언블록
+        heap_pop(&sleep_heap);
+        t->timed_block = false; // thread_block_until()로 잠든 스레드라면 시간 초과
+        unblock_locked(t); // 해당 쓰레드 언블록
+        woken = true;
     }
-    // lock_release(&sleep_lock);
+
+    sleep_stats_add(&sleep_stats.tick_cnt, &sleep_stats.tick_cycles,
+                    &sleep_stats.tick_max, rdtsc() - start);
+    spinlock_release(&sched_lock);
+    if (woken)
+        check_and_preempt(); // 더 높은 우선순위가 깨어났다면 인터럽트 리턴 시 양보
     intr_set_level(old_level);
 }
 
+/* Returns the tick at which the earliest sleeping thread is due
+   or the earliest throttled deadline thread gets its new budget,
+   or INT64_MAX if there is no such thread.  Interrupts must be
+   off. */
+int64_t
+thread_next_wakeup (void) {
+	int64_t wakeup = INT64_MAX;
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	if (!heap_empty (&sleep_heap))
+		wakeup = heap_entry (heap_top (&sleep_heap), struct thread, sleep_elem)->wakeup_tick;
+	for (i = 0; i < cpu_cnt; i++) {
+		struct heap_elem *e = heap_top (&cpus[i].dl_throttled);
+		if (e != NULL) {
+			int64_t deadline = heap_entry (e, struct thread, dl_elem)->dl_deadline;
+			if (deadline < wakeup)
+				wakeup = deadline;
+		}
+	}
+	spinlock_release (&sched_lock);
+	return wakeup;
+}
+
+/* Returns true if every CPU is running its idle thread with
+   nothing on its run queue.  Interrupts must be off. */
+bool
+thread_cpus_idle (void) {
+	bool idle = true;
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&sched_lock);
+	for (i = 0; i < cpu_cnt && idle; i++)
+		idle = cpus[i].curr == cpus[i].idle_thread && cpu_load (&cpus[i]) == 0;
+	spinlock_release (&sched_lock);
+	return idle;
+}
+
+/* Copies the sleep queue statistics into *STATS. */
+void
+thread_get_sleep_stats (struct sleep_stats *stats) {
+	enum intr_level old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	*stats = sleep_stats;
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+}
+
+/* Resets the sleep queue statistics to zero. */
+void
+thread_reset_sleep_stats (void) {
+	enum intr_level old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	memset (&sleep_stats, 0, sizeof sleep_stats);
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 // 현재 스레드의 우선순위가 변경되어 더 이상 가장 높은 우선순위가 아니라면, CPU를 양보시켜야 함.
 void
 thread_set_priority (int new_priority) {
+	enum intr_level old_level;
+
+	/* The 4.4BSD scheduler computes priorities itself. */
+	if (thread_mlfqs)
+		return;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
 	thread_current ()->priority = new_priority;
 
 	/** project1-Priority Inversion Problem */
@@ -401,6 +1091,8 @@ thread_set_priority (int new_priority) {
 
 	/** project1-Priority Inversion Problem */
     refresh_priority();
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
 
 	/** project1-Priority Scheduling */
 	check_and_preempt();
@@ -409,11 +1101,9 @@ thread_set_priority (int new_priority) {
 
 void
 thread_set_priority_orig (int new_priority) {
-  struct thread* front_ready_thread = list_entry(list_begin(&ready_list), struct thread, elem);
-
   thread_current ()->priority = new_priority;
 
-  if (front_ready_thread->priority > new_priority)
+  if (ready_queue_max_priority (this_cpu ()) > new_priority)
     thread_yield();
 }
 
@@ -424,32 +1114,229 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Moves the running thread into the deadline class, asking for
+   RUNTIME ticks of CPU time in every PERIOD ticks, starting now,
+   or takes it back out if RUNTIME is 0.  Returns false, and
+   leaves the thread as it was, if the arguments are out of range
+   or if admitting the thread would raise the utilization of the
+   deadline threads on the current CPU above 1. */
+bool
+thread_set_deadline (int64_t runtime, int64_t period) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+	struct cpu *c;
+	uint64_t util;
+	bool admitted;
+
+	if (runtime < 0 || (runtime > 0 && (runtime > period || period > INT32_MAX)))
+		return false;
+	util = runtime > 0 ? (uint64_t) runtime * DL_UTIL_ONE / period : 0;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	c = this_cpu ();
+	admitted = c->dl_util - dl_util (t) + util <= DL_UTIL_ONE;
+	if (admitted) {
+		c->dl_util = c->dl_util - dl_util (t) + util;
+		t->dl_runtime = runtime;
+		t->dl_period = runtime > 0 ? period : 0;
+		t->dl_deadline = timer_ticks () + period;
+		t->dl_budget = runtime;
+		t->dl_throttled = false;
+	}
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+
+	if (admitted)
+		check_and_preempt ();
+	return admitted;
+}
+
+/*-- Advanced scheduler 과제 --*/
+/* Returns the 4.4BSD priority for T,
+   PRI_MAX - (recent_cpu / 4) - (nice * 2), clamped to the valid
+   range. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = fp_to_int (fp_sub (fp_from_int (PRI_MAX - t->nice * 2),
+	                                  fp_div_int (t->recent_cpu, 4)));
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Adds T to or removes T from mlfqs_threads, depending on whether
+   its recent_cpu or nice is nonzero.  sched_lock must be held. */
+static void
+mlfqs_update_active (struct thread *t) {
+	bool active = t->recent_cpu != 0 || t->nice != 0;
+
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (active && !t->mlfqs_active)
+		list_push_back (&mlfqs_threads, &t->mlfqs_elem);
+	else if (!active && t->mlfqs_active)
+		list_remove (&t->mlfqs_elem);
+	t->mlfqs_active = active;
+}
+
+/* Gives new thread T the nice and recent_cpu values of the
+   running thread, which is creating it, and its priority. */
+static void
+mlfqs_init_thread (struct thread *t) {
+	struct thread *parent = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	spinlock_acquire (&sched_lock);
+	t->nice = parent->nice;
+	t->recent_cpu = parent->recent_cpu;
+	t->priority = mlfqs_priority (t);
+	mlfqs_update_active (t);
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+}
+
+/* Removes exiting thread T from the scheduler's lists.
+   sched_lock must be held. */
+static void
+mlfqs_exit_thread (struct thread *t) {
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (t->mlfqs_active)
+		list_remove (&t->mlfqs_elem);
+	if (t->mlfqs_dirty)
+		list_remove (&t->mlfqs_dirty_elem);
+	t->mlfqs_active = t->mlfqs_dirty = false;
+}
+
+/* Updates the system load average and decays recent_cpu of every
+   thread on mlfqs_threads, recomputing their priorities as it
+   goes.  Called once per second, on the BSP only, with
+   sched_lock held. */
+static void
+mlfqs_decay (void) {
+	int ready_threads = 0;
+	fixed_t twice_load;
+	fixed_t coef;
+	struct list_elem *e;
+	int i;
+
+	/* Every CPU's ready threads and running thread count. */
+	for (i = 0; i < cpu_cnt; i++) {
+		ready_threads += cpus[i].ready_cnt;
+		if (cpus[i].curr != cpus[i].idle_thread)
+			ready_threads++;
+	}
+	load_avg = fp_add (fp_mul (fp_div (fp_from_int (59), fp_from_int (60)),
+	                           load_avg),
+	                   fp_div_int (fp_from_int (ready_threads), 60));
+
+	twice_load = fp_mul_int (load_avg, 2);
+	coef = fp_div (twice_load, fp_add_int (twice_load, 1));
+	for (e = list_begin (&mlfqs_threads); e != list_end (&mlfqs_threads); ) {
+		struct thread *t = list_entry (e, struct thread, mlfqs_elem);
+
+		e = list_next (e);
+		t->recent_cpu = fp_add_int (fp_mul (coef, t->recent_cpu), t->nice);
+		thread_set_effective_priority (t, mlfqs_priority (t));
+		mlfqs_update_active (t);
+	}
+}
+
+/* Timer tick bookkeeping for the 4.4BSD scheduler.  T is the
+   running thread.  Runs in the timer interrupt handler on every
+   CPU, but only the BSP, which owns the system clock, does the
+   system-wide updates. */
+static void
+mlfqs_tick (struct thread *t) {
+	struct cpu *c = this_cpu ();
+	int64_t now = timer_ticks ();
+	bool bsp = c->id == 0;
+
+	spinlock_acquire (&sched_lock);
+
+	/* Charge the tick to the running thread. */
+	if (t != c->idle_thread) {
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+		mlfqs_update_active (t);
+		if (!t->mlfqs_dirty) {
+			list_push_back (&mlfqs_dirty, &t->mlfqs_dirty_elem);
+			t->mlfqs_dirty = true;
+		}
+	}
+
+	if (bsp && now % TIMER_FREQ == 0)
+		mlfqs_decay ();
+
+	/* Every fourth tick, recompute the priorities that changed. */
+	if (now % 4 == 0) {
+		while (bsp && !list_empty (&mlfqs_dirty)) {
+			struct thread *d = list_entry (list_pop_front (&mlfqs_dirty),
+			                               struct thread, mlfqs_dirty_elem);
+			d->mlfqs_dirty = false;
+			thread_set_effective_priority (d, mlfqs_priority (d));
+		}
+		if (t != c->idle_thread && ready_queue_preempts (c, t))
+			intr_yield_on_return ();
+	}
+
+	spinlock_release (&sched_lock);
+}
+
+/* Sets the current thread's nice value to NICE and recomputes its
+   priority.  Yields if it no longer has the highest priority. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sched_lock);
+	t->nice = nice;
+	t->priority = mlfqs_priority (t);
+	mlfqs_update_active (t);
+	spinlock_release (&sched_lock);
+	check_and_preempt ();
+	intr_set_level (old_level);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load_avg_100;
+
+	spinlock_acquire (&sched_lock);
+	load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+	return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent_cpu_100;
+
+	spinlock_acquire (&sched_lock);
+	recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	spinlock_release (&sched_lock);
+	intr_set_level (old_level);
+	return recent_cpu_100;
 }
+/*-- Advanced scheduler 과제 --*/
 
 // // /*-- Priority donation 과제 --*/
 // void donate_priority() {
@@ -464,87 +1351,153 @@ thread_get_recent_cpu (void) {
 //         t->priority = priority;
 //     }
 // }
-void donate_priority(void) {
-    struct thread *curr = thread_current();
-
-    // 현재 스레드가 기다리고 있는 락을 가져옴
-    struct lock *lock = curr->wait_lock;
-
-    // 우선순위 기부의 중첩 깊이를 제한할 변수 초기화
-    int depth = 0;
-
-    // 기다리는 락이 있고, 최대 깊이(8단계)를 넘지 않은 경우 반복
-    while (lock && depth < 8) { // 최대 8단계의 nested donation 허용
-        // 락 보유자가 없는 경우 더 이상 기부할 대상이 없으므로 종료
-        if (!lock->holder)
-            return;
-
-        // 락의 보유자가 현재 스레드보다 낮은 우선순위다?
-        // 우선순위를 현재 스레드의 우선순위로 기부 (덮어씀)
-		lock->holder->priority = 
-			(lock->holder->priority < curr->priority) ? 
-				curr->priority : lock->holder->priority;
-        
-        // 다음 기부 대상은 현재 락의 보유자가 됨
-        curr = lock->holder;
-
-        // 다음 기부를 위해, 그 스레드가 기다리고 있는 락을 가져옴
-        lock = curr->wait_lock;
-
-        // 깊이 증가
-        depth++;
-    }
-	// 나락도 락이다!
+/* Returns the priority T should run at: its own priority, or
+   the highest priority donated to any lock it holds, whichever
+   is higher.  Takes constant time, because the lock with the
+   highest donation is always at the top of T's held_locks. */
+static int
+donated_priority (const struct thread *t) {
+	struct heap_elem *e = heap_top (&t->held_locks);
+	int priority = t->original_priority;
+
+	if (e != NULL) {
+		struct lock_hold *hold = heap_entry (e, struct lock_hold, elem);
+		if (hold->max_priority > priority)
+			priority = hold->max_priority;
+	}
+	return priority;
 }
 
-void remove_with_lock(struct lock *lock)  {
-    struct thread *t = thread_current();
-    struct list_elem *curr = list_begin(&t->donations);
-    struct thread *curr_thread = NULL;
+/* Sets HOLD, one of T's held_locks, to carry a donation of
+   PRIORITY and recomputes T's priority.  Returns true if T's
+   priority changed, in which case T is also re-sorted among the
+   donors of whatever it is waiting for.  sched_lock must be
+   held. */
+bool donate_to_hold(struct thread *t, struct lock_hold *hold, int priority) {
+    ASSERT(spinlock_held(&sched_lock));
+
+    hold->max_priority = priority;
+    heap_update(&t->held_locks, &hold->elem);
+
+    priority = donated_priority(t);
+    if (priority == t->priority)
+        return false;
+    thread_set_effective_priority(t, priority);
+    trace(TRACE_DONATE, t->tid, priority);
+
+    if (t->wait_lock != NULL)
+        heap_update(&t->wait_lock->donors, &t->donor_elem);
+    else if (t->wait_rwlock != NULL)
+        heap_update(&t->wait_rwlock->donors, &t->donor_elem);
+    return true;
+}
 
-    while (curr != list_end(&t->donations))  {
-        curr_thread = list_entry(curr, struct thread, donation_elem);
-        struct list_elem *next = list_next(curr);
+/* Propagates T's priority down the chain of locks it is waiting
+   for and the threads holding them.  A reader-writer lock held
+   shared fans the chain out to every reader.  Each step re-sorts
+   one hold in its holder's held_locks and the holder in the
+   donors of the next lock, in O(log n) time, and the walk stops
+   as soon as a lock's top donor or a holder's priority comes out
+   unchanged.  Thus the chain can be followed all the way without
+   a depth limit.  sched_lock must be held. */
+static void
+donate_from (struct thread *t) {
+    while (t != NULL) {
+        struct lock *lock = t->wait_lock;
+        struct rwlock *rw = t->wait_rwlock;
+        struct thread *top;
+
+        if (lock != NULL) {
+            // 락에 보유자가 있는 동안 체인을 따라 내려감. 깊이 제한 없음.
+            if (lock->holder == NULL)
+                break;
+            top = heap_entry(heap_top(&lock->donors), struct thread, donor_elem);
+
+            // 이 락의 최고 기부 우선순위가 그대로면 더 아래로 바뀔 것도 없음
+            if (top->priority == lock->hold.max_priority)
+                break;
+
+            // 보유자의 우선순위가 그대로여도 멈춤
+            if (!donate_to_hold(lock->holder, &lock->hold, top->priority))
+                break;
+
+            // 보유자도 다른 락을 기다리고 있다면 계속
+            t = lock->holder;
+        } else if (rw != NULL) {
+            top = heap_entry(heap_top(&rw->donors), struct thread, donor_elem);
+            if (top->priority == rw->max_priority)
+                break;
+            rw->max_priority = top->priority;
+
+            // writer가 보유 중이면 락과 같음
+            if (rw->writer != NULL) {
+                if (!donate_to_hold(rw->writer, &rw->writer_hold, top->priority))
+                    break;
+                t = rw->writer;
+                continue;
+            }
+
+            // reader들이 보유 중이면 모든 reader에게 기부하고, 각자의 체인을 따라감
+            struct list_elem *e;
+            for (e = list_begin(&rw->holds); e != list_end(&rw->holds); e = list_next(e)) {
+                struct rwlock_hold *h = list_entry(e, struct rwlock_hold, elem);
+                if (donate_to_hold(h->thread, &h->hold, top->priority))
+                    donate_from(h->thread);
+            }
+            break;
+        } else
+            break;
+    }
+}
 
-        if (curr_thread->wait_lock == lock)
-            list_remove(&curr_thread->donation_elem);
+/* Propagates the current thread's priority to the holders of
+   whatever it is waiting for.  sched_lock must be held. */
+// sched_lock을 쥔 상태에서 호출해야 함.
+void donate_priority(void) {
+    ASSERT(spinlock_held(&sched_lock));
 
-        curr = next;
-    }
+    donate_from(thread_current());
+	// 나락도 락이다!
 }
 
+/* Recomputes the current thread's priority after its own
+   priority or the set of locks it holds has changed.
+   sched_lock must be held. */
 void refresh_priority(void)  {
     struct thread *t = thread_current();
-    t->priority = t->original_priority;
-
-    if (list_empty(&t->donations))
-        return;
-
-    list_sort(&t->donations, thread_priority_cmp, NULL);
 
-    struct list_elem *max_elem = list_front(&t->donations);
-    struct thread *max_thread = list_entry(max_elem, struct thread, donation_elem);
+    ASSERT(spinlock_held(&sched_lock));
 
-    if (t->priority < max_thread->priority)
-        t->priority = max_thread->priority;
+    thread_set_effective_priority(t, donated_priority(t));
 }
 
 /*-- Priority CondVar 과제 --*/
-// 현재 실행 중인 스레드(curr)보다 더 높은 우선순위를 가진 스레드가 ready_list의 가장 앞에 있다면
+// 현재 실행 중인 스레드(curr)보다 더 높은 우선순위를 가진 스레드가 run queue에 있다면
 // 즉시 CPU를 양보(thread_yield())하도록 만듦.
+// 인터럽트 핸들러 안에서 불린 경우(예: 디스크 인터럽트의 sema_up)에는
+// 직접 양보할 수 없으므로 인터럽트 리턴 직전에 양보하도록 예약함.
+// sched_lock을 쥔 상태에서 호출하면 안 됨.
 void check_and_preempt (void) {
+	struct cpu *c;
+	enum intr_level old_level;
+	bool preempt;
+
+	old_level = intr_disable();
+	spinlock_acquire(&sched_lock);
+	c = this_cpu();
+	preempt = thread_current() != c->idle_thread
+		&& ready_queue_preempts(c, thread_current());
+	spinlock_release(&sched_lock);
+	intr_set_level(old_level);
+
 	// 얼리 리턴
-	if (thread_current() == idle_thread)
+	if (!preempt)
 		return;
-	if (list_empty(&ready_list))
-		return;
-
-	// Preempt 들어가야 할지 확인해야 할 경우
-	struct thread *curr = thread_current();
-	struct thread *ready = list_entry(list_front(&ready_list), struct thread, elem);
 
-	if (curr->priority < ready->priority)
-		thread_yield(); // ready_list에 현재 실행 중인 스레드보다 우선순위가 높은 스레드가 있으면 양보시킴.
+	if (intr_context())
+		intr_yield_on_return();
+	else
+		thread_yield(); // run queue에 현재 실행 중인 스레드보다 우선순위가 높은 스레드가 있으면 양보시킴.
 }
 /*-- Priority CondVar 과제 --*/
 /*-- Priority donation 과제 --*/
@@ -552,25 +1505,62 @@ void check_and_preempt (void) {
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
+   The BSP's idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes the CPU's idle_thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when the ready list is
+   empty.  The other CPUs' idle threads are the code that booted
+   them; see thread_start_ap(). */
 static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	intr_disable ();
+	this_cpu ()->idle_thread = thread_current ();
+	intr_enable ();
 	sema_up (idle_started);
+	idle_loop ();
+}
+
+/* Returns true if a thread is waiting to run on the current
+   CPU.  Does not take sched_lock, so the answer is only a hint,
+   but a thread woken after it is checked wakes up the CPU with
+   an interrupt anyway. */
+static bool
+idle_has_work (void) {
+	struct cpu *c = this_cpu ();
 
+	return __atomic_load_n (&c->ready_cnt, __ATOMIC_RELAXED) > 0
+		|| __atomic_load_n (&c->dl_cnt, __ATOMIC_RELAXED) > 0;
+}
+
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void) {
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
+		timer_idle_exit ();
 		thread_block ();
 
+		/* Nothing else to run, so zero free pages for PAL_ZERO
+		   until something is, or until there are enough.  The
+		   idle thread is never preempted, so look for work
+		   after each page, and go run it instead of halting. */
+		intr_enable ();
+		while (!idle_has_work () && palloc_zero_idle ())
+			continue;
+		intr_disable ();
+		if (idle_has_work ())
+			continue;
+
+		/* In tickless mode, stop the periodic tick until the
+		   next sleeper is due. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -592,6 +1582,7 @@ static void
 kernel_thread (thread_func *function, void *aux) {
 	ASSERT (function != NULL);
 
+	spinlock_release (&sched_lock);  /* Handed over by schedule(). */
 	intr_enable ();       /* The scheduler runs with interrupts off. */
 	function (aux);       /* Execute the thread function. */
 	thread_exit ();       /* If function() returns, kill the thread. */
@@ -613,8 +1604,9 @@ init_thread (struct thread *t, const char *name, int priority) {
 
 	/*-- Priority donation 과제 --*/
     t->priority = t->original_priority = priority;
-    list_init(&t->donations);
+    heap_init(&t->held_locks, held_lock_less, NULL);
     t->wait_lock = NULL;
+    t->wait_rwlock = NULL;
 	/*-- Priority donation 과제 --*/
 
 	t->magic = THREAD_MAGIC;
@@ -629,20 +1621,182 @@ init_thread (struct thread *t, const char *name, int priority) {
 	sema_init(&t->exit_sema, 0);
 	sema_init(&t->wait_sema, 0);
 	list_init(&(t->child_list));
+	t->leader = t; // thread_create 시스템 콜로 만든 스레드는 시작하면서 바꿈
+	lock_init(&t->thread_lock);
+	cond_init(&t->threads_done);
 	// ~ project 2. user programs
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Appends T to the tail of the run queue for its priority on
+   T's CPU, so that threads of equal priority are scheduled
+   round-robin.  A deadline thread goes into the CPU's dl_queue
+   instead, or into dl_throttled if it is out of budget.
+   sched_lock must be held. */
+static void
+ready_queue_push (struct thread *t) {
+	struct cpu *c = t->cpu;
+
+	ASSERT (spinlock_held (&sched_lock));
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	if (t->dl_period != 0) {
+		if (t->dl_throttled)
+			heap_push (&c->dl_throttled, &t->dl_elem);
+		else {
+			heap_push (&c->dl_queue, &t->dl_elem);
+			c->dl_cnt++;
+		}
+		return;
+	}
+	if (thread_fair) {
+		heap_push (&c->fair_queue, &t->fair_elem);
+		c->fair_weight += fair_weights[t->priority];
+	} else {
+		list_push_back (&c->ready_queues[t->priority], &t->elem);
+		c->ready_mask |= 1ULL << t->priority;
+	}
+	c->ready_cnt++;
+}
+
+/* Removes ready thread T from its CPU's run queue.  T must still
+   be queued under its current priority.  sched_lock must be
+   held. */
+static void
+ready_queue_remove (struct thread *t) {
+	struct cpu *c = t->cpu;
+
+	ASSERT (spinlock_held (&sched_lock));
+	ASSERT (t->status == THREAD_READY);
+
+	if (t->dl_period != 0) {
+		if (t->dl_throttled)
+			heap_remove (&c->dl_throttled, &t->dl_elem);
+		else {
+			heap_remove (&c->dl_queue, &t->dl_elem);
+			c->dl_cnt--;
+		}
+		return;
+	}
+	if (thread_fair) {
+		heap_remove (&c->fair_queue, &t->fair_elem);
+		c->fair_weight -= fair_weights[t->priority];
+	} else {
+		list_remove (&t->elem);
+		if (list_empty (&c->ready_queues[t->priority]))
+			c->ready_mask &= ~(1ULL << t->priority);
+	}
+	c->ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread on
+   CPU C, or -1 if its run queue is empty. */
+static int
+ready_queue_max_priority (const struct cpu *c) {
+	return c->ready_mask != 0 ? 63 - __builtin_clzll (c->ready_mask) : -1;
+}
+
+/* Returns true if a thread in CPU C's run queue should preempt
+   CURR, which is running on C.  sched_lock must be held. */
+static bool
+ready_queue_preempts (const struct cpu *c, const struct thread *curr) {
+	if (c->dl_cnt > 0)
+		return thread_preempts (heap_entry (heap_top (&c->dl_queue),
+		                                    struct thread, dl_elem), curr);
+	if (dl_runnable (curr))
+		return false;
+	if (thread_fair) {
+		struct heap_elem *e = heap_top (&c->fair_queue);
+		return e != NULL
+			&& thread_preempts (heap_entry (e, struct thread, fair_elem), curr);
+	}
+	return ready_queue_max_priority (c) > curr->priority;
+}
+
+/* Returns true if ready thread T should preempt running thread
+   CURR.  A deadline thread preempts any other thread and is
+   preempted only by one with an earlier deadline.  Under the
+   proportional-share scheduler, T must be behind CURR in virtual
+   runtime by more than FAIR_WAKEUP_GRAN, so that two threads do
+   not keep preempting each other. */
+static bool
+thread_preempts (const struct thread *t, const struct thread *curr) {
+	if (dl_runnable (t) || dl_runnable (curr))
+		return dl_runnable (t)
+			&& (!dl_runnable (curr) || t->dl_deadline < curr->dl_deadline);
+	if (thread_fair)
+		return t->vruntime + FAIR_WAKEUP_GRAN < curr->vruntime;
+	return t->priority > curr->priority;
+}
+
+/* Sets T's effective priority to PRIORITY.  If T is ready, it is
+   moved to the tail of the run queue for its new priority.
+   sched_lock must be held. */
+void
+thread_set_effective_priority (struct thread *t, int priority) {
+	ASSERT (spinlock_held (&sched_lock));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	if (t->priority == priority)
+		return;
+	if (t->status == THREAD_READY) {
+		ready_queue_remove (t);
+		t->priority = priority;
+		ready_queue_push (t);
+	} else
+		t->priority = priority;
+
+	/* Keep its place in a wait queue in step.  It may still be
+	   on one while ready, if its wait just timed out. */
+	if (t->waitq != NULL)
+		heap_update (t->wait_exclusive ? &t->waitq->exclusive
+		                               : &t->waitq->shared, &t->wait_elem);
+}
+
+/* Chooses and returns the next thread to be scheduled on this
+   CPU.  Should return a thread from the CPU's run queue, unless
+   the run queue is empty.  (If the running thread can continue
+   running, then it will be in the run queue.)  Runnable deadline
+   threads come first.  If the run queue is empty, try to steal a
+   thread from the busiest CPU, and if there is nothing to steal,
+   return the CPU's idle thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct cpu *c = this_cpu ();
+	struct list *queue;
+	struct thread *t;
+	int pri;
+
+	if (c->dl_cnt > 0) {
+		t = heap_entry (heap_top (&c->dl_queue), struct thread, dl_elem);
+		ready_queue_remove (t);
+		return t;
+	}
+
+	if (c->ready_cnt == 0 && cpu_cnt > 1) {
+		struct cpu *busiest = busiest_cpu (c);
+		if (busiest != NULL) {
+			steal_thread (busiest, c);
+			c->idle_steals++;
+		}
+	}
+	if (c->ready_cnt == 0)
+		return c->idle_thread;
+
+	if (thread_fair) {
+		t = heap_entry (heap_top (&c->fair_queue), struct thread, fair_elem);
+		ready_queue_remove (t);
+		if (t->vruntime > c->min_vruntime)
+			c->min_vruntime = t->vruntime;
+		return t;
+	}
+
+	pri = ready_queue_max_priority (c);
+	queue = &c->ready_queues[pri];
+	t = list_entry (list_pop_front (queue), struct thread, elem);
+	if (list_empty (queue))
+		c->ready_mask &= ~(1ULL << pri);
+	c->ready_cnt--;
+	return t;
 }
 
 
@@ -674,87 +1828,46 @@ do_iret (struct intr_frame *tf) {
 			: : "g" ((uint64_t) tf) : "memory");
 }
 
-/* Switching the thread by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Switches from the running thread to TH.
+
+   At this function's invocation, interrupts are disabled, and so
+   they are when control comes back here, some time later, in the
+   thread that called it.
 
-   At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.
+   Both threads are in kernel mode, so this is a plain function
+   call as far as either of them can tell, and thread_switch()
+   only needs to save the callee-saved registers and the stack
+   pointer.  The full intr_frame and `iretq' of do_iret() are used
+   only to start a thread for the first time; returning to user
+   mode goes through the interrupt and system call exit paths, as
+   always.
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
    added at the end of the function. */
 static void
 thread_launch (struct thread *th) {
-	uint64_t tf_cur = (uint64_t) &running_thread ()->tf;
-	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
 
-	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
-	__asm __volatile (
-			/* Store registers that will be used. */
-			"push %%rax\n"
-			"push %%rbx\n"
-			"push %%rcx\n"
-			/* Fetch input once */
-			"movq %0, %%rax\n"
-			"movq %1, %%rcx\n"
-			"movq %%r15, 0(%%rax)\n"
-			"movq %%r14, 8(%%rax)\n"
-			"movq %%r13, 16(%%rax)\n"
-			"movq %%r12, 24(%%rax)\n"
-			"movq %%r11, 32(%%rax)\n"
-			"movq %%r10, 40(%%rax)\n"
-			"movq %%r9, 48(%%rax)\n"
-			"movq %%r8, 56(%%rax)\n"
-			"movq %%rsi, 64(%%rax)\n"
-			"movq %%rdi, 72(%%rax)\n"
-			"movq %%rbp, 80(%%rax)\n"
-			"movq %%rdx, 88(%%rax)\n"
-			"pop %%rbx\n"              // Saved rcx
-			"movq %%rbx, 96(%%rax)\n"
-			"pop %%rbx\n"              // Saved rbx
-			"movq %%rbx, 104(%%rax)\n"
-			"pop %%rbx\n"              // Saved rax
-			"movq %%rbx, 112(%%rax)\n"
-			"addq $120, %%rax\n"
-			"movw %%es, (%%rax)\n"
-			"movw %%ds, 8(%%rax)\n"
-			"addq $32, %%rax\n"
-			"call __next\n"         // read the current rip.
-			"__next:\n"
-			"pop %%rbx\n"
-			"addq $(out_iret -  __next), %%rbx\n"
-			"movq %%rbx, 0(%%rax)\n" // rip
-			"movw %%cs, 8(%%rax)\n"  // cs
-			"pushfq\n"
-			"popq %%rbx\n"
-			"mov %%rbx, 16(%%rax)\n" // eflags
-			"mov %%rsp, 24(%%rax)\n" // rsp
-			"movw %%ss, 32(%%rax)\n"
-			"mov %%rcx, %%rdi\n"
-			"call do_iret\n"
-			"out_iret:\n"
-			: : "g"(tf_cur), "g" (tf) : "memory"
-			);
-}
-
-/* Schedules a new process. At entry, interrupts must be off.
+	thread_switch (&running_thread ()->switch_rsp, th->switch_rsp, &th->tf);
+}
+
+/* Schedules a new process. At entry, interrupts must be off and
+ * sched_lock must be held.
  * This function modify current thread's status to status and then
  * finds another thread to run and switches to it.
  * It's not safe to call printf() in the schedule(). */
 static void
 do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (spinlock_held (&sched_lock));
 	ASSERT (thread_current()->status == THREAD_RUNNING);
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		if (victim->fd_table != NULL)
+			cache_put (&fdt_cache, victim->fd_table);
+		cache_put (&thread_cache, victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -762,24 +1875,44 @@ do_schedule(int status) {
 
 static void
 schedule (void) {
+	struct cpu *c = this_cpu ();
 	struct thread *curr = running_thread ();
 	struct thread *next = next_thread_to_run ();
 
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (spinlock_held (&sched_lock));
 	ASSERT (curr->status != THREAD_RUNNING);
 	ASSERT (is_thread (next));
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	next->cpu = c;
+	c->curr = next;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	c->thread_ticks = 0;
+	if (thread_fair)
+		c->time_slice = fair_time_slice (c, next);
 
 #ifdef USERPROG
 	/* Activate the new address space. */
 	process_activate (next);
+	if (curr != next)
+		fpu_switch (curr, next);
 #endif
 
 	if (curr != next) {
+		uint64_t now = rdtsc ();
+
+		trace (TRACE_SWITCH, next->tid, curr->tid);
+
+		/* Charge CURR up to now and start charging NEXT. */
+		curr->usage.kernel_cycles += now - curr->acct_tsc;
+		if (curr->status == THREAD_BLOCKED)
+			curr->usage.nvcsw++;
+		else if (curr->status == THREAD_READY)
+			curr->usage.nivcsw++;
+		next->acct_tsc = now;
+
 		/* If the thread we switched from is dying, destroy its struct
 		   thread. This must happen late so that thread_exit() doesn't
 		   pull out the rug under itself.
@@ -798,6 +1931,67 @@ schedule (void) {
 	}
 }
 
+/* Initializes CACHE for objects of PAGE_CNT pages each, which
+   are allocated with FLAGS when the cache is empty. */
+static void
+cache_init (struct object_cache *cache, size_t page_cnt,
+            enum palloc_flags flags) {
+	spinlock_init (&cache->lock);
+	cache->free = NULL;
+	cache->free_cnt = 0;
+	cache->page_cnt = page_cnt;
+	cache->flags = flags;
+}
+
+/* Takes an object out of CACHE, or allocates a new one if CACHE
+   is empty.  Returns a null pointer if memory is exhausted. */
+static void *
+cache_get (struct object_cache *cache) {
+	enum intr_level old_level;
+	void **obj;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&cache->lock);
+	obj = cache->free;
+	if (obj != NULL) {
+		cache->free = *obj;
+		cache->free_cnt--;
+	}
+	spinlock_release (&cache->lock);
+	intr_set_level (old_level);
+
+	if (obj == NULL)
+		return palloc_get_multiple (cache->flags, cache->page_cnt);
+
+	/* Restore the word used for the free list. */
+	if (cache->flags & PAL_ZERO)
+		*obj = NULL;
+	return obj;
+}
+
+/* Returns OBJ to CACHE, or to palloc if CACHE is full.  May be
+   called with sched_lock held. */
+static void
+cache_put (struct object_cache *cache, void *obj_) {
+	enum intr_level old_level;
+	void **obj = obj_;
+	bool cached;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&cache->lock);
+	cached = cache->free_cnt < CACHE_MAX;
+	if (cached) {
+		*obj = cache->free;
+		cache->free = obj;
+		cache->free_cnt++;
+	}
+	spinlock_release (&cache->lock);
+	intr_set_level (old_level);
+
+	if (!cached)
+		palloc_free_multiple (obj, cache->page_cnt);
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -810,3 +2004,159 @@ allocate_tid (void) {
 
 	return tid;
 }
+
+/* Orders a CPU's fair_queue by virtual runtime, least on top. */
+static bool
+fair_vruntime_less (const struct heap_elem *a, const struct heap_elem *b,
+                    void *aux UNUSED) {
+	const struct thread *ta = heap_entry (a, struct thread, fair_elem);
+	const struct thread *tb = heap_entry (b, struct thread, fair_elem);
+	return ta->vruntime < tb->vruntime;
+}
+
+/* Fills in fair_weights[]. */
+static void
+fair_init (void) {
+	uint64_t weight;
+	int pri;
+
+	weight = FAIR_WEIGHT0;
+	for (pri = PRI_DEFAULT; pri <= PRI_MAX; pri++) {
+		fair_weights[pri] = weight;
+		weight = weight * FAIR_WEIGHT_STEP_NUM / FAIR_WEIGHT_STEP_DEN;
+	}
+	weight = FAIR_WEIGHT0;
+	for (pri = PRI_DEFAULT - 1; pri >= PRI_MIN; pri--) {
+		weight = weight * FAIR_WEIGHT_STEP_DEN / FAIR_WEIGHT_STEP_NUM;
+		fair_weights[pri] = weight > 0 ? weight : 1;
+	}
+}
+
+/* Sets the virtual runtime of T, which is about to join CPU C's
+   run queue after sleeping or being created, so that it is not
+   far behind the threads already there.  Otherwise a thread that
+   slept for a long time would have the CPU to itself until it
+   caught up.  sched_lock must be held. */
+static void
+fair_place (struct thread *t, struct cpu *c) {
+	uint64_t floor = c->min_vruntime > FAIR_SLEEPER_CREDIT
+		? c->min_vruntime - FAIR_SLEEPER_CREDIT : 0;
+
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (t->vruntime < floor)
+		t->vruntime = floor;
+}
+
+/* Charges T, running on CPU C, for a timer tick, and moves C's
+   minimum virtual runtime forward.  Called from thread_tick(),
+   which preempts T at the end of its time slice. */
+static void
+fair_tick (struct cpu *c, struct thread *t) {
+	struct heap_elem *e;
+	uint64_t min;
+
+	spinlock_acquire (&sched_lock);
+	t->vruntime += (uint64_t) FAIR_WEIGHT0 * FAIR_WEIGHT0
+		/ fair_weights[t->priority];
+
+	min = t->vruntime;
+	e = heap_top (&c->fair_queue);
+	if (e != NULL && heap_entry (e, struct thread, fair_elem)->vruntime < min)
+		min = heap_entry (e, struct thread, fair_elem)->vruntime;
+	if (min > c->min_vruntime)
+		c->min_vruntime = min;
+	spinlock_release (&sched_lock);
+}
+
+/* Returns the number of ticks T may run on CPU C before it is
+   preempted: its share of FAIR_LATENCY among the threads ready
+   on C, but at least one tick. */
+static unsigned
+fair_time_slice (const struct cpu *c, const struct thread *t) {
+	uint64_t weight;
+	unsigned slice;
+
+	if (t == c->idle_thread)
+		return TIME_SLICE;
+
+	weight = fair_weights[t->priority];
+	slice = FAIR_LATENCY * weight / (weight + c->fair_weight);
+	return slice > 0 ? slice : 1;
+}
+
+/* Orders a CPU's dl_queue and dl_throttled by absolute deadline,
+   earliest on top. */
+static bool
+dl_deadline_less (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED) {
+	const struct thread *ta = heap_entry (a, struct thread, dl_elem);
+	const struct thread *tb = heap_entry (b, struct thread, dl_elem);
+	return ta->dl_deadline < tb->dl_deadline;
+}
+
+/* Returns true if T is a deadline thread with budget left. */
+static bool
+dl_runnable (const struct thread *t) {
+	return t->dl_period != 0 && !t->dl_throttled;
+}
+
+/* Returns the utilization of T, in units of DL_UTIL_ONE, or 0 if
+   T is not a deadline thread. */
+static uint64_t
+dl_util (const struct thread *t) {
+	return t->dl_period != 0
+		? (uint64_t) t->dl_runtime * DL_UTIL_ONE / t->dl_period : 0;
+}
+
+/* Gives deadline thread T, which is waking up at tick NOW, a full
+   budget and a deadline one period from NOW, unless it can use
+   up the budget it has left by its current deadline without
+   exceeding its utilization.  A thread that blocked while
+   throttled stays throttled until its deadline.  sched_lock must
+   be held. */
+static void
+dl_wakeup (struct thread *t, int64_t now) {
+	ASSERT (spinlock_held (&sched_lock));
+
+	if (now >= t->dl_deadline
+			|| t->dl_budget * t->dl_period > (t->dl_deadline - now) * t->dl_runtime) {
+		t->dl_deadline = now + t->dl_period;
+		t->dl_budget = t->dl_runtime;
+		t->dl_throttled = false;
+	}
+}
+
+/* Charges T, running on CPU C, for a timer tick if it is a
+   deadline thread, throttling it if that uses up its budget, and
+   gives the throttled threads on C whose deadlines have come a
+   new budget and deadline.  Returns true if T should be
+   preempted. */
+static bool
+dl_tick (struct cpu *c, struct thread *t) {
+	int64_t now = timer_ticks ();
+	struct heap_elem *e;
+	bool preempt;
+
+	spinlock_acquire (&sched_lock);
+	if (t->dl_period != 0 && --t->dl_budget <= 0)
+		t->dl_throttled = true;
+
+	while ((e = heap_top (&c->dl_throttled)) != NULL) {
+		struct thread *d = heap_entry (e, struct thread, dl_elem);
+		if (d->dl_deadline > now)
+			break;
+		ready_queue_remove (d);
+		d->dl_deadline += d->dl_period;
+		if (d->dl_deadline <= now)
+			d->dl_deadline = now + d->dl_period;
+		d->dl_budget = d->dl_runtime;
+		d->dl_throttled = false;
+		ready_queue_push (d);
+	}
+
+	preempt = t != c->idle_thread
+		&& (t->dl_throttled || ready_queue_preempts (c, t));
+	spinlock_release (&sched_lock);
+	return preempt;
+}
@@ -0,0 +1,128 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Scheduler event trace.
+
+   Each CPU records events into a ring buffer of its own, so
+   recording takes no lock: a CPU only has to keep its own
+   interrupt handlers out while it fills in a slot.  When a ring
+   is full, the oldest events are overwritten.  Every event has a
+   TSC time stamp, which is cheap to read and, unlike printf(),
+   does not disturb the timing being looked at.
+
+   At power off, trace_dump() prints the rings to the console,
+   one line per event, prefixed by "trace:".  utils/pintos-trace
+   turns that output into a timeline for chrome://tracing or
+   Perfetto. */
+
+#define TRACE_PAGES 8           /* Ring size per CPU, in pages. */
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+
+/* One recorded event. */
+struct trace_event {
+	uint64_t tsc;               /* Time stamp counter. */
+	uint32_t type;              /* enum trace_type. */
+	int32_t tid;                /* Thread the event is about. */
+	int64_t arg;                /* Depends on type. */
+};
+
+/* A CPU's ring.  Only that CPU writes to it. */
+struct trace_ring {
+	struct trace_event *events; /* TRACE_EVENTS slots. */
+	uint64_t head;              /* Number of events ever recorded. */
+};
+
+bool trace_enabled;
+bool trace_on;
+
+static struct trace_ring rings[CPU_MAX];
+
+/* TSC and timer tick when recording started, to work out the
+   TSC frequency. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Names printed by trace_dump(). */
+static const char *type_names[TRACE_TYPE_CNT] = {
+	[TRACE_SWITCH] = "switch",
+	[TRACE_WAKEUP] = "wakeup",
+	[TRACE_BLOCK] = "block",
+	[TRACE_SLEEP] = "sleep",
+	[TRACE_DONATE] = "donate",
+	[TRACE_IRQ_ENTER] = "irq",
+	[TRACE_IRQ_EXIT] = "irq-exit",
+};
+
+/* Allocates a ring for every CPU and starts recording, if
+   tracing was asked for.  Must be called after smp_init(). */
+void
+trace_init (void) {
+	int i;
+
+	if (!trace_enabled)
+		return;
+
+	for (i = 0; i < cpu_cnt; i++) {
+		rings[i].events = palloc_get_multiple (PAL_ASSERT, TRACE_PAGES);
+		rings[i].head = 0;
+	}
+	start_tsc = rdtsc ();
+	start_ticks = timer_ticks ();
+	trace_on = true;
+}
+
+/* Records an event of the given TYPE about thread TID, with
+   argument ARG, in the running CPU's ring.  Use trace() instead,
+   which skips the call when tracing is off. */
+void
+trace_record (enum trace_type type, int tid, int64_t arg) {
+	enum intr_level old_level = intr_disable ();
+	struct trace_ring *ring = &rings[this_cpu ()->id];
+
+	if (ring->events != NULL) {
+		struct trace_event *e = &ring->events[ring->head % TRACE_EVENTS];
+		e->tsc = rdtsc ();
+		e->type = type;
+		e->tid = tid;
+		e->arg = arg;
+		ring->head++;
+	}
+	intr_set_level (old_level);
+}
+
+/* Stops recording and prints every CPU's ring to the console,
+   oldest event first. */
+void
+trace_dump (void) {
+	int64_t ticks;
+	uint64_t hz;
+	int i;
+
+	if (!trace_on)
+		return;
+	trace_on = false;
+
+	ticks = timer_ticks () - start_ticks;
+	hz = ticks > 0 ? (rdtsc () - start_tsc) / ticks * TIMER_FREQ : 0;
+	printf ("trace: begin %d cpus %llu hz\n", cpu_cnt, hz);
+	for (i = 0; i < cpu_cnt; i++) {
+		struct trace_ring *ring = &rings[i];
+		uint64_t n = ring->head > TRACE_EVENTS ? ring->head - TRACE_EVENTS : 0;
+
+		if (n > 0)
+			printf ("trace: cpu %d lost %llu\n", i, n);
+		for (; n < ring->head; n++) {
+			struct trace_event *e = &ring->events[n % TRACE_EVENTS];
+			printf ("trace: %d %llu %s %d %lld\n",
+					i, e->tsc, type_names[e->type], e->tid, e->arg);
+		}
+	}
+	printf ("trace: end\n");
+}
@@ -0,0 +1,215 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "intrinsic.h"
+
+/* Virtually contiguous allocations.
+
+   palloc_get_multiple() needs physically contiguous pages, which
+   run out under fragmentation long before memory does.  vmalloc()
+   instead takes pages one at a time from the kernel pool and maps
+   them at consecutive addresses in [VMALLOC_START, VMALLOC_END).
+
+   That range lies under the same page map level 4 entry as the
+   rest of the kernel, so every pml4 that pml4_create() copies
+   from base_pml4 shares the page tables below it, and a mapping
+   added here shows up in all address spaces at once.
+
+   Each allocation is followed by an unmapped guard page, which
+   catches overruns and marks where the allocation ends.
+
+   Freeing unmaps the pages right away, but other CPUs may still
+   have the old translations in their TLBs, so the addresses are
+   not handed out again until a TLB shootdown (smp_flush_tlb())
+   has happened.  Freed ranges are collected and shot down in one
+   go, once enough of them pile up or the range runs out.
+
+   vmalloc() and vfree() may sleep, so they must not be called
+   from an interrupt handler or with a spinlock held. */
+
+/* Pages in the vmalloc range. */
+#define VMALLOC_PAGES (VMALLOC_SIZE / PGSIZE)
+
+/* Freed pages that may wait for a TLB shootdown. */
+#define VMALLOC_LAZY_MAX 1024
+
+_Static_assert (PML4 (VMALLOC_START) == PML4 (KERN_BASE), "pml4 entry");
+_Static_assert (PML4 (VMALLOC_END - 1) == PML4 (KERN_BASE), "pml4 entry");
+
+/* Page I of the range is in use (mapped, guard, or awaiting a
+   shootdown) iff bit I of used_map is set.  A set bit in
+   guard_map is the guard page that ends an allocation, and a set
+   bit in stale_map is a freed page awaiting a shootdown. */
+#define VMALLOC_MAP_WORDS (VMALLOC_PAGES / 64 + 2)
+static uint64_t used_buf[VMALLOC_MAP_WORDS];
+static uint64_t guard_buf[VMALLOC_MAP_WORDS];
+static uint64_t stale_buf[VMALLOC_MAP_WORDS];
+static struct bitmap *used_map, *guard_map, *stale_map;
+static size_t stale_cnt;
+
+/* Protects the maps and the page tables under the range. */
+static struct lock vmalloc_lock;
+
+static void unmap_range (size_t idx, size_t page_cnt);
+static void purge (void);
+
+/* Returns the address of page IDX of the range. */
+static inline void *
+page_addr (size_t idx) {
+	return (void *) (VMALLOC_START + (uint64_t) idx * PGSIZE);
+}
+
+/* Returns the page index of ADDR in the range. */
+static inline size_t
+page_idx (const void *addr) {
+	ASSERT (is_vmalloc_vaddr (addr));
+	return ((uint64_t) addr - VMALLOC_START) / PGSIZE;
+}
+
+/* Initializes the vmalloc range.  base_pml4 must exist. */
+void
+vmalloc_init (void) {
+	ASSERT (base_pml4 != NULL);
+	ASSERT (base_pml4[PML4 (VMALLOC_START)] & PTE_P);
+
+	used_map = bitmap_create_in_buf (VMALLOC_PAGES, used_buf, sizeof used_buf);
+	guard_map = bitmap_create_in_buf (VMALLOC_PAGES, guard_buf,
+	                                  sizeof guard_buf);
+	stale_map = bitmap_create_in_buf (VMALLOC_PAGES, stale_buf,
+	                                  sizeof stale_buf);
+	lock_init (&vmalloc_lock);
+}
+
+/* Obtains and returns SIZE bytes of virtually contiguous kernel
+   memory, rounded up to whole pages and not zeroed.  Returns a
+   null pointer if memory or address space is not available. */
+void *
+vmalloc (size_t size) {
+	size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+	size_t idx, i;
+
+	ASSERT (used_map != NULL);
+	ASSERT (!intr_context ());
+
+	if (page_cnt == 0 || page_cnt >= VMALLOC_PAGES)
+		return NULL;
+
+	lock_acquire (&vmalloc_lock);
+	if (stale_cnt >= VMALLOC_LAZY_MAX)
+		purge ();
+	idx = bitmap_scan_and_flip (used_map, 0, page_cnt + 1, false);
+	if (idx == BITMAP_ERROR && stale_cnt > 0) {
+		purge ();
+		idx = bitmap_scan_and_flip (used_map, 0, page_cnt + 1, false);
+	}
+	if (idx == BITMAP_ERROR) {
+		lock_release (&vmalloc_lock);
+		return NULL;
+	}
+	bitmap_mark (guard_map, idx + page_cnt);
+
+	for (i = 0; i < page_cnt; i++) {
+		void *kpage = palloc_get_page (0);
+		uint64_t *pte = NULL;
+
+		if (kpage != NULL)
+			pte = pml4e_walk (base_pml4, (uint64_t) page_addr (idx + i), 1);
+		if (pte == NULL) {
+			palloc_free_page (kpage);
+			unmap_range (idx, page_cnt);
+			lock_release (&vmalloc_lock);
+			return NULL;
+		}
+		*pte = vtop (kpage) | PTE_P | PTE_W;
+	}
+	lock_release (&vmalloc_lock);
+
+	return page_addr (idx);
+}
+
+/* Frees P, which must have been returned by vmalloc(). */
+void
+vfree (void *p) {
+	size_t idx;
+
+	if (p == NULL)
+		return;
+	ASSERT (pg_ofs (p) == 0);
+	ASSERT (!intr_context ());
+
+	idx = page_idx (p);
+	lock_acquire (&vmalloc_lock);
+	ASSERT (bitmap_test (used_map, idx) && !bitmap_test (stale_map, idx));
+	unmap_range (idx, bitmap_scan (guard_map, idx, 1, true) - idx);
+	lock_release (&vmalloc_lock);
+}
+
+/* Returns the number of bytes vmalloc() allocated for P. */
+size_t
+vmalloc_size (const void *p) {
+	size_t idx = page_idx (p);
+	size_t page_cnt;
+
+	ASSERT (pg_ofs (p) == 0);
+
+	lock_acquire (&vmalloc_lock);
+	page_cnt = bitmap_scan (guard_map, idx, 1, true) - idx;
+	lock_release (&vmalloc_lock);
+	return page_cnt * PGSIZE;
+}
+
+/* Unmaps and frees whatever pages are mapped among the PAGE_CNT
+   pages starting at IDX, and leaves them and the guard page after
+   them for purge() to recycle. */
+static void
+unmap_range (size_t idx, size_t page_cnt) {
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&vmalloc_lock));
+
+	for (i = 0; i < page_cnt; i++) {
+		void *va = page_addr (idx + i);
+		uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) va, 0);
+
+		if (pte != NULL && (*pte & PTE_P)) {
+			void *kpage = ptov (PTE_ADDR (*pte));
+
+			*pte = 0;
+			invlpg ((uint64_t) va);
+			palloc_free_page (kpage);
+		}
+	}
+	bitmap_reset (guard_map, idx + page_cnt);
+	bitmap_set_multiple (stale_map, idx, page_cnt + 1, true);
+	stale_cnt += page_cnt + 1;
+}
+
+/* Shoots down every CPU's TLB, after which the freed pages can no
+   longer be reached through a stale translation, and returns them
+   to the free part of the range. */
+static void
+purge (void) {
+	size_t idx = 0;
+
+	ASSERT (lock_held_by_current_thread (&vmalloc_lock));
+
+	smp_flush_tlb ();
+	while ((idx = bitmap_scan (stale_map, idx, 1, true)) != BITMAP_ERROR) {
+		size_t end = bitmap_scan (stale_map, idx, 1, false);
+
+		if (end == BITMAP_ERROR)
+			end = VMALLOC_PAGES;
+		bitmap_set_multiple (used_map, idx, end - idx, false);
+		bitmap_set_multiple (stale_map, idx, end - idx, false);
+		idx = end;
+	}
+	stale_cnt = 0;
+}
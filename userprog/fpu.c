@@ -0,0 +1,211 @@
+#include "userprog/fpu.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/smp.h"
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+
+/* Lazy FPU context switching.
+
+   The x87, MMX and SSE registers of a user process are saved in
+   a 512-byte FXSAVE area that is allocated the first time the
+   process uses any of them, so threads that never touch the FPU
+   neither pay for saving and restoring it nor use the memory.
+
+   Whenever a thread is switched in, CR0.TS is set, unless the
+   registers still hold that thread's state.  Its first FPU
+   instruction then raises #NM (device not available), and
+   fpu_trap() loads its state and clears TS.  When a thread that
+   has cleared TS is switched out, its state is saved, so that
+   the saved area is always current for a thread that is not
+   running and it can be resumed on any CPU.
+
+   The kernel itself is compiled with -mno-sse -msoft-float and
+   never uses the FPU. */
+
+#define CR0_TS (1 << 3)         /* Task Switched. */
+#define CR0_MP (1 << 1)         /* Monitor Coprocessor. */
+#define CR0_EM (1 << 2)         /* Emulation. */
+#define CR4_OSFXSR (1 << 9)     /* FXSAVE/FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT (1 << 10) /* #XF for SIMD exceptions. */
+
+/* Size and required alignment of an FXSAVE area. */
+#define FXSAVE_SIZE 512
+#define FXSAVE_ALIGN 16
+
+/* FPU state of a freshly started process. */
+static uint8_t initial_state[FXSAVE_SIZE]
+	__attribute__ ((aligned (FXSAVE_ALIGN)));
+
+static void fpu_trap (struct intr_frame *);
+
+static inline uint64_t
+rcr0 (void) {
+	uint64_t cr0;
+	asm volatile ("movq %%cr0, %0" : "=r" (cr0));
+	return cr0;
+}
+
+static inline void
+lcr0 (uint64_t cr0) {
+	asm volatile ("movq %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+static inline void
+clts (void) {
+	asm volatile ("clts" : : : "memory");
+}
+
+static inline void
+stts (void) {
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Returns the 16-byte aligned FXSAVE area inside the block
+   allocated for thread T. */
+static void *
+fpu_area (const struct thread *t) {
+	return (void *) (((uintptr_t) t->fpu_state + FXSAVE_ALIGN - 1)
+	                 & ~(uintptr_t) (FXSAVE_ALIGN - 1));
+}
+
+/* Allocates an FXSAVE area for T, initialized to the state of a
+   freshly started process.  Returns false if memory is
+   exhausted. */
+static bool
+fpu_alloc (struct thread *t) {
+	t->fpu_state = malloc (FXSAVE_SIZE + FXSAVE_ALIGN - 1);
+	if (t->fpu_state == NULL)
+		return false;
+	memcpy (fpu_area (t), initial_state, FXSAVE_SIZE);
+	return true;
+}
+
+/* Enables the FPU on the bootstrap processor, records the
+   initial FPU state for new processes and starts handling
+   #NM. */
+void
+fpu_init (void) {
+	fpu_init_cpu ();
+
+	clts ();
+	asm volatile ("fninit; fxsave %0" : "=m" (initial_state));
+	stts ();
+
+	intr_register_int (7, 0, INTR_ON, fpu_trap,
+			"#NM Device Not Available Exception");
+}
+
+/* Enables the FPU and SSE on the running CPU, with TS set so
+   that the first use traps. */
+void
+fpu_init_cpu (void) {
+	uint64_t cr4;
+
+	lcr0 ((rcr0 () & ~CR0_EM) | CR0_MP | CR0_TS);
+	asm volatile ("movq %%cr4, %0" : "=r" (cr4));
+	cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+	asm volatile ("movq %0, %%cr4" : : "r" (cr4));
+}
+
+/* Called by schedule() just before switching from PREV to NEXT,
+   with interrupts off.  Saves PREV's FPU state if it has used
+   the FPU since it was switched in, and arranges for NEXT's
+   first FPU instruction to trap unless NEXT's state is still
+   in this CPU's registers. */
+void
+fpu_switch (struct thread *prev, struct thread *next) {
+	struct cpu *c = this_cpu ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if ((rcr0 () & CR0_TS) == 0 && prev->fpu_state != NULL)
+		asm volatile ("fxsave %0" : "=m" (*(uint8_t (*)[FXSAVE_SIZE]) fpu_area (prev)));
+
+	if (c->fpu_owner == next && next->fpu_cpu == c)
+		clts ();
+	else
+		stts ();
+}
+
+/* Saves the running thread's FPU state if it is loaded in this
+   CPU's registers, so that its saved area is current even though
+   it has not been switched out.  The registers stay loaded. */
+void
+fpu_save_current (void) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	if ((rcr0 () & CR0_TS) == 0 && t->fpu_state != NULL)
+		asm volatile ("fxsave %0" : "=m" (*(uint8_t (*)[FXSAVE_SIZE]) fpu_area (t)));
+	intr_set_level (old_level);
+}
+
+/* Gives CHILD, a process being forked from PARENT, a copy of
+   PARENT's FPU state.  The child may run on another CPU before
+   PARENT is ever switched out, so PARENT must have called
+   fpu_save_current() before creating CHILD, and must stay in the
+   kernel until the fork finishes, so that its saved state is
+   current.  Returns false if memory is exhausted. */
+bool
+fpu_fork (struct thread *child, struct thread *parent) {
+	if (parent->fpu_state == NULL)
+		return true;
+	if (!fpu_alloc (child))
+		return false;
+	memcpy (fpu_area (child), fpu_area (parent), FXSAVE_SIZE);
+	return true;
+}
+
+/* Throws away the running thread's FPU state, for exec and exit.
+   Its next FPU instruction, if any, starts over from the initial
+   state. */
+void
+fpu_discard (void) {
+	struct thread *t = thread_current ();
+	struct cpu *c;
+	enum intr_level old_level;
+	void *state;
+
+	old_level = intr_disable ();
+	c = this_cpu ();
+	if (c->fpu_owner == t)
+		c->fpu_owner = NULL;
+	state = t->fpu_state;
+	t->fpu_state = NULL;
+	t->fpu_cpu = NULL;
+	stts ();
+	intr_set_level (old_level);
+
+	free (state);
+}
+
+/* #NM handler.  Loads the running thread's FPU state, allocating
+   it on first use, and lets the faulting instruction run again. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+	struct cpu *c;
+
+	if ((f->cs & 3) != 3)
+		PANIC ("FPU used in kernel mode at %p", (void *) f->rip);
+
+	/* May sleep, so do this before touching the registers. */
+	if (t->fpu_state == NULL && !fpu_alloc (t))
+		exit (-1);
+
+	old_level = intr_disable ();
+	c = this_cpu ();
+	clts ();
+	if (c->fpu_owner != t || t->fpu_cpu != c) {
+		asm volatile ("fxrstor %0" : : "m" (*(uint8_t (*)[FXSAVE_SIZE]) fpu_area (t)));
+		c->fpu_owner = t;
+		t->fpu_cpu = c;
+	}
+	intr_set_level (old_level);
+}
@@ -0,0 +1,172 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Fast user-space mutexes.
+
+   A user program keeps its lock or condition in an int in its
+   own memory and only makes a system call when it has to sleep
+   or wake someone up.  futex_wait() sleeps only if the int still
+   holds the value the caller expects, which it checks with the
+   wait queue locked, so a futex_wake() that follows a change to
+   the int cannot slip in between the check and the sleep.
+
+   Waiters are keyed by the kernel virtual address of the int,
+   that is, by its frame plus its offset within the page, so
+   threads that map the same frame meet on the same key whatever
+   user address they use.  A frame that is evicted while threads
+   wait on it takes the key with it, so waiters should expect
+   spurious timeouts in that case, as with any futex. */
+
+/* Number of hash buckets.  Must be a power of 2. */
+#define FUTEX_BUCKETS 64
+
+/* A hash bucket: the waiters on every key that hashes to it. */
+struct futex_bucket {
+	struct spinlock lock;       /* Protects waiters. */
+	struct list waiters;        /* struct futex_waiters, FIFO. */
+};
+
+/* A thread sleeping in futex_wait(), on its own stack. */
+struct futex_waiter {
+	struct list_elem elem;      /* Element in bucket's waiters. */
+	const int *key;             /* Kernel address of the int. */
+	struct thread *thread;      /* Sleeping thread. */
+	bool woken;                 /* Taken off the list by futex_wake()? */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void) {
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		spinlock_init (&buckets[i].lock);
+		list_init (&buckets[i].waiters);
+	}
+}
+
+/* Returns the bucket for KEY. */
+static struct futex_bucket *
+bucket_of (const int *key) {
+	uintptr_t x = (uintptr_t) key / sizeof *key;
+
+	x ^= x >> 7;
+	x ^= x >> 13;
+	return &buckets[x & (FUTEX_BUCKETS - 1)];
+}
+
+/* Returns the kernel address of the int at user address UADDR
+   in the running process, bringing its page in through the
+   supplemental page table if it is not present, or a null
+   pointer if UADDR is misaligned or not mapped. */
+static int *
+futex_key (int *uaddr) {
+	struct thread *t = thread_current ();
+	void *kva;
+
+	if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+		return NULL;
+
+	kva = pml4_get_page (t->pml4, uaddr);
+#ifdef VM
+	if (kva == NULL && vm_claim_page (pg_round_down (uaddr)))
+		kva = pml4_get_page (t->pml4, uaddr);
+#endif
+	return kva;
+}
+
+/* If the int at user address UADDR equals EXPECTED, sleeps until
+   futex_wake() is called on an address that maps to the same
+   int, or until TIMEOUT_MS milliseconds have passed, if
+   TIMEOUT_MS is not negative.  Returns 0 if woken up by
+   futex_wake(), 1 on timeout, or -1 if the int did not equal
+   EXPECTED.  Terminates the process if UADDR is bad. */
+int
+futex_wait (int *uaddr, int expected, int timeout_ms) {
+	int *key = futex_key (uaddr);
+	struct futex_bucket *b;
+	struct futex_waiter w;
+	enum intr_level old_level;
+	int64_t end_tick = INT64_MAX;
+
+	if (key == NULL)
+		exit (-1);
+	if (timeout_ms >= 0)
+		end_tick = timer_ticks ()
+			+ DIV_ROUND_UP ((int64_t) timeout_ms * TIMER_FREQ, 1000);
+
+	b = bucket_of (key);
+	w.key = key;
+	w.thread = thread_current ();
+	w.woken = false;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&b->lock);
+	if (*key != expected) {
+		spinlock_release (&b->lock);
+		intr_set_level (old_level);
+		return -1;
+	}
+	list_push_back (&b->waiters, &w.elem);
+	thread_block_until (&b->lock, end_tick);
+
+	/* Timed out, unless a futex_wake() got to us first. */
+	if (!w.woken)
+		list_remove (&w.elem);
+	spinlock_release (&b->lock);
+	intr_set_level (old_level);
+
+	return w.woken ? 0 : 1;
+}
+
+/* Wakes up to CNT threads waiting in futex_wait() on the int at
+   user address UADDR, oldest first, and returns the number
+   woken.  Terminates the process if UADDR is bad. */
+int
+futex_wake (int *uaddr, int cnt) {
+	int *key = futex_key (uaddr);
+	struct futex_bucket *b;
+	struct list_elem *e, *next;
+	enum intr_level old_level;
+	int woken = 0;
+
+	if (key == NULL)
+		exit (-1);
+
+	b = bucket_of (key);
+	old_level = intr_disable ();
+	spinlock_acquire (&b->lock);
+	for (e = list_begin (&b->waiters);
+	     e != list_end (&b->waiters) && woken < cnt; e = next) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		next = list_next (e);
+		if (w->key != key)
+			continue;
+		list_remove (&w->elem);
+		w->woken = true;
+		thread_wake (w->thread);
+		woken++;
+	}
+	spinlock_release (&b->lock);
+
+	if (woken > 0)
+		check_and_preempt ();
+	intr_set_level (old_level);
+	return woken;
+}
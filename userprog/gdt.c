@@ -1,8 +1,10 @@
 #include "userprog/gdt.h"
 #include <debug.h>
+#include <string.h>
 #include "userprog/tss.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 
@@ -61,7 +63,9 @@ struct segment_descriptor64 {
 	type, 1, dpl, 1, (unsigned) (lim) >> 28, 0, 1, 0, 1, \
 	(unsigned) (base) >> 24 }
 
-static struct segment_desc gdt[SEL_CNT] = {
+/* Template for each CPU's GDT.  They differ only in the TSS
+   descriptor, because every CPU has its own TSS. */
+static const struct segment_desc gdt_template[SEL_CNT] = {
 	[SEL_NULL >> 3] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 	[SEL_KCSEG >> 3] = SEG64 (0xa, 0x0, 0xffffffff, 0),
 	[SEL_KDSEG >> 3] = SEG64 (0x2, 0x0, 0xffffffff, 0),
@@ -72,19 +76,26 @@ static struct segment_desc gdt[SEL_CNT] = {
 	[7] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 
-struct desc_ptr gdt_ds = {
-	.size = sizeof(gdt) - 1,
-	.address = (uint64_t) gdt
-};
+/* Per-CPU GDTs. */
+static struct segment_desc gdts[CPU_MAX][SEL_CNT];
 
-/* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+/* Sets up a proper GDT on the running CPU.  The bootstrap
+   loader's GDT didn't include user-mode selectors or a TSS, but
+   we need both now.  tss_init() must have been called on this
+   CPU first. */
 void
 gdt_init (void) {
 	/* Initialize GDT. */
+	struct segment_desc *gdt = gdts[this_cpu ()->id];
 	struct segment_descriptor64 *tss_desc =
 		(struct segment_descriptor64 *) &gdt[SEL_TSS >> 3];
 	struct task_state *tss = tss_get ();
+	struct desc_ptr gdt_ds = {
+		.size = sizeof gdt_template - 1,
+		.address = (uint64_t) gdt
+	};
+
+	memcpy (gdt, gdt_template, sizeof gdt_template);
 
 	*tss_desc = (struct segment_descriptor64) {
 		.lim_15_0 = (uint64_t) (sizeof (struct task_state)) & 0xffff,
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
@@ -15,6 +16,7 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -27,10 +29,29 @@
 #define MAX_ARGS 128
 #define MAX_BUF 128
 
+/* thread_create 시스템 콜로 만든 스레드들의 유저 스택.
+ * 슬롯 i의 스택은 메인 스택이 자랄 수 있는 1 MB (STACK_MAX_SIZE) 아래,
+ * THREAD_STACK_TOP - i * THREAD_STACK_SIZE에서 아래로 자람. */
+#define THREAD_SLOTS 32                                  // 프로세스당 동시에 살아있을 수 있는 스레드 수 (stack_slots의 비트 수)
+#define THREAD_STACK_PAGES 8
+#define THREAD_STACK_SIZE (THREAD_STACK_PAGES * PGSIZE)
+#define THREAD_STACK_TOP (USER_STACK - (1 << 20))
+
+/* process_thread_create()가 새 스레드에게 넘기는 정보. */
+struct thread_start {
+	struct intr_frame if_;      // 유저 모드로 진입할 때의 레지스터
+	struct thread *leader;      // 합류할 프로세스
+	int stack_slot;             // 새 스레드의 스택 슬롯
+};
+
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void __do_thread (void *);
+static int reap_child (struct thread *);
+static void release_threads (struct thread *);
+static bool setup_thread_stack (void *stack_bottom);
 
 /* General process initializer for initd and other process. */
 static void process_init (void) {
@@ -45,8 +66,13 @@ int process_add_file(struct file *file_obj){
 
 	int fd = curr->next_fd; // fd값은 2부터 출발
 	
-	while (curr->fd_table[fd] != NULL && fd < FDCOUNT_LIMIT) {
-		fd++;
+	// fd 테이블은 같은 프로세스의 스레드들이 공유하므로, 빈 칸을 CAS로 차지
+	for (; fd < FDCOUNT_LIMIT; fd++) {
+		struct file *empty = NULL;
+		if (fdt[fd] == NULL
+				&& __atomic_compare_exchange_n (&fdt[fd], &empty, file_obj, false,
+				                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			break;
 	}
 
 	if (fd >= FDCOUNT_LIMIT) {
@@ -54,7 +80,6 @@ int process_add_file(struct file *file_obj){
 	}
 
 	curr->next_fd = fd;
-	fdt[fd] = file_obj;
 
 	return fd;
 }
@@ -88,15 +113,16 @@ struct thread *process_get_child(int pid) {
     return NULL; // 못 찾았으니 NULL를 리턴.
 }
 
-// 현재 스레드의 fdt로부터 해당 fd의 파일 객체를 제거
-void process_close_file_by_id(int fd){
+// 현재 스레드의 fdt로부터 해당 fd의 파일 객체를 제거하고 리턴. 없으면 NULL
+// 같은 프로세스의 스레드들이 동시에 닫아도 한 스레드만 파일 객체를 받도록 교환은 atomic하게
+struct file *process_close_file_by_id(int fd){
 	struct thread *curr = thread_current();
 	struct file **fdt = curr->fd_table;
 
 	if (fd < 2 || fd >= FDCOUNT_LIMIT)
 		return NULL;
 
-	fdt[fd] = NULL;
+	return __atomic_exchange_n(&fdt[fd], NULL, __ATOMIC_SEQ_CST);
 }
 
 /* Starts the first userland program, called "initd", loaded from FILE_NAME.
@@ -150,6 +176,9 @@ tid_t process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 	struct thread *curr = thread_current();
 	memcpy(&curr->parent_if, if_, sizeof(struct intr_frame)); // TODO: 스택에 넣지 말고 PALLOC로 확보하는 방향으로.
 	
+    // 자식은 부모가 스위치 아웃되기 전에 다른 CPU에서 돌 수 있으므로 FPU 상태를 먼저 저장
+    fpu_save_current();
+
     // 자식 생성 시 부모를 넘김
     tid_t tid = thread_create(name, PRI_DEFAULT, __do_fork, curr);
 	if (tid == TID_ERROR)
@@ -239,7 +268,7 @@ static void __do_fork (void *aux) { // 여기서 aux가 부모.
 	process_activate (current);
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
-	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy (&current->spt, &parent->leader->spt))
 		goto error;
 #else
 	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
@@ -263,11 +292,16 @@ static void __do_fork (void *aux) { // 여기서 aux가 부모.
 	}
 	current->next_fd = parent->next_fd;
 
+	// 부모의 FPU 상태도 복제. 부모는 load_sema에서 기다리는 중이라 저장된 상태가 최신임
+	if (!fpu_fork (current, parent))
+		goto error;
+
 	sema_up(&current->load_sema); // 자식 동기화 대기 해제
 	process_init ();
 
 	/* Finally, switch to the newly created process. */
 	if (succ){
+		thread_charge_kernel ();
 		do_iret (&if_);
 	}
 
@@ -278,6 +312,105 @@ error:
 	exit(-2);
 }
 
+/* Starts a new thread in the current process, which runs user
+ * code at ENTRY with ARG1 and ARG2 as its first two arguments,
+ * on a fresh stack below the main thread's.  The new thread
+ * shares the caller's page table, supplemental page table and fd
+ * table.  IF_ supplies its segment registers and flags.  Returns
+ * the new thread's id, which the caller may pass to
+ * process_thread_join(), or TID_ERROR. */
+tid_t process_thread_create (void *entry, uint64_t arg1, uint64_t arg2,
+		struct intr_frame *if_) {
+	struct thread *curr = thread_current ();
+	struct thread *leader = curr->leader;
+	struct thread_start start;
+	tid_t tid;
+	int slot;
+
+	if (entry == NULL || !is_user_vaddr (entry))
+		return TID_ERROR;
+
+	// 빈 스택 슬롯을 찾고, 처음 쓰는 슬롯이면 스택을 만들어 둠.
+	// 한 번 만든 스택은 프로세스가 끝날 때까지 두고 다음 스레드가 재사용
+	lock_acquire (&leader->thread_lock);
+	for (slot = 0; slot < THREAD_SLOTS; slot++)
+		if (!(leader->stack_slots & (1u << slot)))
+			break;
+	if (slot == THREAD_SLOTS
+			|| (!(leader->stacks_mapped & (1u << slot))
+				&& !setup_thread_stack ((uint8_t *) THREAD_STACK_TOP
+				                        - (slot + 1) * THREAD_STACK_SIZE))) {
+		lock_release (&leader->thread_lock);
+		return TID_ERROR;
+	}
+	leader->stack_slots |= 1u << slot;
+	leader->stacks_mapped |= 1u << slot;
+	leader->thread_cnt++; // 새 스레드가 시작하기 전에 리더가 끝나 버리지 않도록 미리 셈
+	lock_release (&leader->thread_lock);
+
+	memcpy (&start.if_, if_, sizeof start.if_);
+	memset (&start.if_.R, 0, sizeof start.if_.R);
+	start.if_.rip = (uintptr_t) entry;
+	start.if_.R.rdi = arg1;
+	start.if_.R.rsi = arg2;
+	// 함수에 call로 들어간 것처럼 (rsp + 8)이 16바이트 정렬되도록
+	start.if_.rsp = THREAD_STACK_TOP - slot * THREAD_STACK_SIZE - sizeof (void *);
+	start.leader = leader;
+	start.stack_slot = slot;
+
+	tid = thread_create (curr->name, PRI_DEFAULT, __do_thread, &start);
+	if (tid == TID_ERROR) {
+		lock_acquire (&leader->thread_lock);
+		leader->stack_slots &= ~(1u << slot);
+		if (--leader->thread_cnt == 0)
+			cond_signal (&leader->threads_done, &leader->thread_lock);
+		lock_release (&leader->thread_lock);
+		return TID_ERROR;
+	}
+
+	// 새 스레드가 start를 다 읽을 때까지 대기 (start는 이 스택에 있음)
+	sema_down (&process_get_child (tid)->load_sema);
+	return tid;
+}
+
+/* A thread function that starts a thread made by
+ * process_thread_create() in user mode. */
+static void __do_thread (void *aux) {
+	struct thread_start *start = aux;
+	struct thread *current = thread_current ();
+	struct thread *leader = start->leader;
+	struct intr_frame if_;
+
+	memcpy (&if_, &start->if_, sizeof if_);
+	current->leader = leader;
+	current->stack_slot = start->stack_slot;
+
+	// 리더의 주소 공간과 fd 테이블을 공유. thread_create()가 준 fd 테이블은 돌려줌
+	current->pml4 = leader->pml4;
+	thread_put_fd_table (current->fd_table);
+	current->fd_table = leader->fd_table;
+	process_activate (current);
+
+	sema_up (&current->load_sema); // 이제 start는 필요 없음
+	process_init ();
+
+	thread_charge_kernel ();
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
+/* Waits for thread TID, which the current thread started with
+ * process_thread_create(), to exit and returns its exit status.
+ * Returns -1 immediately if TID is not such a thread or was
+ * already joined. */
+int process_thread_join (tid_t tid) {
+	struct thread *child = process_get_child (tid);
+
+	if (child == NULL || child->leader == child)
+		return -1;
+	return reap_child (child);
+}
+
 void argument_stack(char **argv, int argc, void **rsp) {
 	// Save argument strings (character by character)
 	for (int i = argc - 1; i >= 0; i--) {
@@ -339,9 +472,7 @@ int process_exec (void *f_name) {
 	_if.cs = SEL_UCSEG;
 	_if.eflags = FLAG_IF | FLAG_MBS;
 
-	// lock_acquire(&g_filesys_lock);
 	// struct file *new_file = filesys_open(parse[0]);
-	// lock_release(&g_filesys_lock);
 	
 	/* We first kill the current context */
 	process_cleanup ();
@@ -371,6 +502,7 @@ int process_exec (void *f_name) {
     // ~  Project 2. User Programs의 Argument Passing
 
     /* Start switched process. */
+    thread_charge_kernel();
     do_iret(&_if);
     NOT_REACHED();
 }
@@ -392,11 +524,17 @@ int process_wait (tid_t child_tid UNUSED) {
 	// struct thread *curr = thread_current();
 	struct thread *child = process_get_child(child_tid);
 
-	if (child == NULL)
+	if (child == NULL || child->leader != child) // 같은 프로세스의 스레드는 process_thread_join()으로
 		return -1;
-	
+	return reap_child(child);
+}
+
+/* Waits for CHILD, a thread in the current thread's child list,
+ * to exit, lets it go and returns its exit status. */
+static int reap_child (struct thread *child) {
 	sema_down(&child->wait_sema); 
 	int exit_status = child->exit_status;
+	thread_reap_usage(child); // 자식(과 자식이 기다린 자손들)의 CPU 사용량을 합산
 	// timer_msleep(1); // 그 동안 고마웠어!
 	list_remove(&child->child_elem);
 	sema_up(&child->exit_sema);
@@ -410,30 +548,74 @@ void process_exit (void) {
 		* TODO: Implement process termination message (see
 		* TODO: project2/process_termination.html).
 		* TODO: We recommend you to implement process resource cleanup here. */
+	struct thread *leader = curr->leader;
 
+	// 아직 join되지 않은 스레드들은 더 이상 기다려 줄 스레드가 없으니 끝나는 대로 소멸하도록
+	release_threads (curr);
 
-	// 프로세스의 파일 디스크립터들을 닫기
-	for (int i = 2; i < FDCOUNT_LIMIT; i++) {
-		if (curr->fd_table[i] != NULL)
-			close(i);
-	}
-	palloc_free_multiple(curr->fd_table, FDT_PAGES);
+	if (leader != curr) {
+		// process_thread_create()로 만든 스레드: 공유 자원은 리더가 정리하므로 자기 몫만
+		fpu_discard ();
+		curr->fd_table = NULL;
+		curr->pml4 = NULL;
+		pml4_activate (NULL);
+
+		lock_acquire (&leader->thread_lock);
+		leader->stack_slots &= ~(1u << curr->stack_slot);
+		if (--leader->thread_cnt == 0)
+			cond_signal (&leader->threads_done, &leader->thread_lock);
+		lock_release (&leader->thread_lock);
+	} else {
+		// 프로세스의 첫 스레드: 다른 스레드가 모두 끝난 뒤에 공유 자원을 정리
+		lock_acquire (&curr->thread_lock);
+		while (curr->thread_cnt > 0)
+			cond_wait (&curr->threads_done, &curr->thread_lock);
+		lock_release (&curr->thread_lock);
+
+		// 프로세스의 파일 디스크립터들을 닫기
+		// close()가 항목을 NULL로 비우므로 fd 테이블은 빈 상태로 남고,
+		// 스레드가 소멸될 때 thread.c의 fdt_cache로 돌아가 재사용됨
+		for (int i = 2; i < FDCOUNT_LIMIT; i++) {
+			if (curr->fd_table[i] != NULL)
+				close(i);
+		}
 
-	// 프로세스의 파일 디스크립터들만 닫았으니 이제 바이너리를 닫기
-	if (curr->running != NULL) {
-		file_allow_write(curr->running); // 잡았다 요놈!
-		file_close(curr->running);
+		// 프로세스의 파일 디스크립터들만 닫았으니 이제 바이너리를 닫기
+		if (curr->running != NULL) {
+			file_allow_write(curr->running); // 잡았다 요놈!
+			file_close(curr->running);
+		}
+		process_cleanup ();
 	}
-	process_cleanup ();
 
+	thread_charge_kernel (); // 부모가 합산하기 전에 사용량을 마감
 	sema_up(&curr->wait_sema); // 대기 중이던 부모를 깨우기
 	sema_down(&curr->exit_sema); // 자기 (부모의 시그널 대기)
 }
 
+/* Lets every thread that T started with process_thread_create()
+ * and has not joined die as soon as it exits, since nobody is
+ * left to join it. */
+static void release_threads (struct thread *t) {
+	struct list_elem *e = list_begin (&t->child_list);
+
+	while (e != list_end (&t->child_list)) {
+		struct thread *child = list_entry (e, struct thread, child_elem);
+
+		e = list_next (e);
+		if (child->leader != child) {
+			list_remove (&child->child_elem);
+			sema_up (&child->exit_sema);
+		}
+	}
+}
+
 /* Free the current process's resources. */
 static void process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
+	fpu_discard ();
+
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
 #endif
@@ -544,13 +726,10 @@ static bool load (const char *file_name, struct intr_frame *if_) {
 		goto done;
 	process_activate (thread_current ());
 
-   	lock_acquire(&g_filesys_lock);	
 	/* Open executable file. */
 	file = filesys_open (file_name);
-  	// lock_release(&g_filesys_lock);
 	if (file == NULL) {
 		printf ("load: %s: open failed\n", file_name);
-  		// lock_release(&g_filesys_lock);
 		goto done;
 	}
 	
@@ -642,7 +821,6 @@ static bool load (const char *file_name, struct intr_frame *if_) {
 done:
 	/* We arrive here whether the load is successful or not. */
 	// file_close (file); // TODO: 여기 말고 process_exit에서 닫도록 해야.
-  	lock_release(&g_filesys_lock);
 	return success;
 }
 
@@ -790,6 +968,26 @@ install_page (void *upage, void *kpage, bool writable) {
 	return (pml4_get_page (t->pml4, upage) == NULL
 			&& pml4_set_page (t->pml4, upage, kpage, writable));
 }
+
+/* Maps THREAD_STACK_PAGES zeroed pages from STACK_BOTTOM up for
+ * a thread started by process_thread_create(). */
+static bool
+setup_thread_stack (void *stack_bottom) {
+	uint8_t *upage = stack_bottom;
+
+	for (int i = 0; i < THREAD_STACK_PAGES; i++, upage += PGSIZE) {
+		if (pml4_get_page (thread_current ()->pml4, upage) != NULL)
+			continue; // 지난번에 중간까지 만들다 실패한 스택
+		uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+		if (kpage == NULL)
+			return false;
+		if (!install_page (upage, kpage, true)) {
+			palloc_free_page (kpage);
+			return false;
+		}
+	}
+	return true;
+}
 #else
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
@@ -819,15 +1017,12 @@ bool lazy_load_segment (struct page *page, void *aux) {
 	size_t page_read_bytes = fla->read_bytes;
 	size_t page_zero_bytes 	= PGSIZE - page_read_bytes;
 
-	lock_acquire(&g_filesys_lock);
-    // file_read_at을 사용!
+    // file_read_at을 사용! 파일 위치를 건드리지 않으므로 락 없이 다른 read와 동시에 진행됨
     if (file_read_at(fla->file, kva, fla->read_bytes, fla->ofs) != (int) fla->read_bytes) {
-		lock_release(&g_filesys_lock);
 		palloc_free_page(kva);
-		free(fla);
+		kmem_cache_free(lazy_aux_cache, fla);
         return false;
     }
-	lock_release(&g_filesys_lock);
 
 	// 나머지는 zero fill
 	memset(kva + fla->read_bytes, 0, page_zero_bytes);
@@ -863,7 +1058,7 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct file_lazy_aux* fla = (struct file_lazy_aux *)malloc(sizeof(struct file_lazy_aux));
+		struct file_lazy_aux* fla = kmem_cache_alloc(lazy_aux_cache);
 		fla->file = file;					 // 내용이 담긴 파일 객체
 		fla->ofs = ofs;					 // 이 페이지에서 읽기 시작할 위치
 		fla->read_bytes = page_read_bytes; // 이 페이지에서 읽어야 하는 바이트 수
@@ -904,4 +1099,17 @@ static bool setup_stack (struct intr_frame *if_) {
 
     return success;
 }
+
+/* Reserves THREAD_STACK_PAGES anonymous pages from STACK_BOTTOM
+ * up for a thread started by process_thread_create().  They are
+ * claimed on first touch like any other lazy page. */
+static bool setup_thread_stack (void *stack_bottom) {
+	uint8_t *upage = stack_bottom;
+
+	for (int i = 0; i < THREAD_STACK_PAGES; i++, upage += PGSIZE)
+		if (!vm_alloc_page (VM_ANON, upage, true)
+				&& spt_find_page (&thread_current ()->leader->spt, upage) == NULL)
+			return false; // 이미 있는 페이지는 지난번에 중간까지 만들다 실패한 스택
+	return true;
+}
 #endif /* VM */
\ No newline at end of file
@@ -12,6 +12,9 @@
 #include "threads/loader.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
+#include "threads/smp.h"
+#include "devices/timer.h"
+#include "userprog/futex.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
@@ -32,6 +35,7 @@ void check_address(const uint64_t *addr);
 #define MSR_STAR 0xc0000081         /* Segment selector msr */
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* GS base after swapgs */
 
 #define PAL_ZERO 0
 
@@ -171,7 +175,7 @@ void* mmap(void *addr, size_t length, int writable, int fd, off_t offset){
 		return NULL;
 
 	// must fail if overlaps any existing set of mapped pages
-	if (spt_find_page(&curr->spt, addr))
+	if (spt_find_page(&curr->leader->spt, addr))
 		return NULL;
 
 	// if addr is 0, it must fail
@@ -224,6 +228,8 @@ void seek(int fd, unsigned position) {
 
 /**
  * exit - 해당 프로세스를 종료시킴.
+ * thread_create()로 만든 스레드가 부르면 그 스레드만 종료하고, status는 join()의 리턴값이 됨.
+ * 프로세스는 첫 스레드가 exit()하고 다른 스레드도 모두 끝나면 종료.
  * 
  * @param status: 현재 상태를 가져오는 파라미터.
  */
@@ -231,7 +237,8 @@ void exit(int status) {
 	struct thread *curr = thread_current();
     curr->exit_status = status; // 프로그램이 정상적으로 종료되었는지 확인(정상적 종료 시 0)
 
-	printf("%s: exit(%d)\n", thread_name(), status); // 디버그용
+	if (curr->leader == curr) // 종료 메시지는 프로세스당 한 번
+		printf("%s: exit(%d)\n", thread_name(), status); // 디버그용
 	thread_exit(); // 스레드 종료
 }
 
@@ -245,28 +252,20 @@ void exit(int status) {
 int write(int fd, const void *buffer, unsigned size){
     validate_read_buffer(buffer, size); // 이거 validate_read_buffer라고 쓴 거 맞습니다!!!!!
 
-	struct thread *curr = thread_current();
-
-	lock_acquire(&g_filesys_lock);
-
+	// 파일 시스템은 inode, 디렉터리, free map마다 자체 락으로 보호됨
 	int bytes_write = 0;
 	if (fd == STDOUT_FILENO) { // stdout면 직접 작성
 		putbuf(buffer, size);
 		bytes_write = size;
 	} else {
-		if (fd < 2) {
-			lock_release(&g_filesys_lock);
+		if (fd < 2)
 			return -1;
-		}
 
 		struct file *file = process_get_file_by_fd(fd);
-		if (file == NULL){
-			lock_release(&g_filesys_lock);
+		if (file == NULL)
 			return -1;
-		}
 		bytes_write = file_write(file, buffer, size);
 	}
-	lock_release(&g_filesys_lock);
 
 	return bytes_write;
 }
@@ -288,6 +287,11 @@ tid_t fork(char *thr_name, struct intr_frame *if_) {
  */
 int exec(char *file_name) {
 	check_address(file_name);
+
+	// 다른 스레드들이 아직 주소 공간을 쓰고 있으면 갈아엎을 수 없음
+	struct thread *curr = thread_current();
+	if (curr->leader != curr || curr->thread_cnt > 0)
+		return -1;
 	
 	// 새로운 페이지 한 장(4KB)을 제로필 후 확보.
 	// June 02 : User Zero 동시 옵션으로 업데이트, 도움이 되느지는 잘 모르..겟ㅇ어요
@@ -317,11 +321,7 @@ int exec(char *file_name) {
 bool create(const char *file, unsigned initial_size) {		
 	check_address(file);
 
-	lock_acquire(&g_filesys_lock);
-	bool result = filesys_create(file, initial_size);
-	lock_release(&g_filesys_lock);
-
-	return result;
+	return filesys_create(file, initial_size);
 }
 
 /**
@@ -332,13 +332,7 @@ bool create(const char *file, unsigned initial_size) {
  */
 bool remove(const char *file) {
 	check_address(file);
-	bool result;
-
-	lock_acquire(&g_filesys_lock);
-	result = filesys_remove(file);
-	lock_release(&g_filesys_lock);
-
-	return result;
+	return filesys_remove(file);
 }
 
 
@@ -352,7 +346,6 @@ int open(const char *filename) {
 	check_address(filename); // 이상한 포인터면 즉시 종료
 	int fd = -1;
 
-	lock_acquire(&g_filesys_lock);
 	struct file *file_obj = filesys_open(filename);
 	
 	if (file_obj == NULL) {
@@ -369,7 +362,6 @@ int open(const char *filename) {
 	
 	goto done;
 done:
-	lock_release(&g_filesys_lock);
 	return fd;
 }
 
@@ -380,15 +372,11 @@ done:
  * @param fd: 닫을 파일 디스크립터.
  */
 void close(int fd) {
-	struct file *file_obj = process_get_file_by_fd(fd);
+	struct file *file_obj = process_close_file_by_id(fd); // fd 테이블에서 먼저 떼어내야 다른 스레드와 두 번 닫지 않음
 	if (file_obj == NULL)
 		return;
 
-	lock_acquire(&g_filesys_lock);
 	file_close(file_obj);
-	lock_release(&g_filesys_lock);
-
-	process_close_file_by_id(fd);
 }
 
 /**
@@ -439,15 +427,19 @@ int read(int fd, void *buffer, unsigned size){
     if (file == NULL)
         return -1; // 해당 파일이 NULL이면 즉시 리턴.
 
-    // 4. 정상적인 파일이면 read
-    off_t ret;
-    lock_acquire(&g_filesys_lock);
-    ret = file_read(file, buffer, size);
-    lock_release(&g_filesys_lock);
-    return ret;
+    // 4. 정상적인 파일이면 read. 다른 파일의 read와는 동시에 진행됨
+    return file_read(file, buffer, size);
 }
 
 void syscall_init (void) {
+	syscall_init_cpu ();
+	futex_init ();
+}
+
+/* Points the running CPU's syscall MSRs at syscall_entry.  The
+   BSP does this in syscall_init(), and every application
+   processor does it for itself while starting up. */
+void syscall_init_cpu (void) {
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48  |
 			((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t) syscall_entry);
@@ -458,12 +450,15 @@ void syscall_init (void) {
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 
-	lock_init(&g_filesys_lock); // Project 2. User Programs
+	/* syscall_entry finds this CPU's struct cpu through swapgs. */
+	write_msr(MSR_KERNEL_GS_BASE, (uint64_t) this_cpu ());
 }
 
 /* The main system call interface */
 void syscall_handler (struct intr_frame *f UNUSED) {
 	int sys_call_number = (int) f->R.rax; // 시스템 콜 번호 받아옴
+
+	thread_charge_user(); // 여기까지는 유저 모드에서 쓴 시간
 	// printf("syscall_handler - sys_call_number: %d\n",sys_call_number);
 
 	// Project 3. Virtual Memory ~
@@ -546,10 +541,33 @@ void syscall_handler (struct intr_frame *f UNUSED) {
 			// printf("SYS_MUNMAP [%d]\n", sys_call_number);
 			munmap((void *)f->R.rdi);
 			break;
+		case SYS_SET_DEADLINE:
+			f->R.rax = thread_set_deadline((int64_t)f->R.rdi, (int64_t)f->R.rsi);
+			break;
+		case SYS_GETRUSAGE:
+			validate_write_buffer((void *)f->R.rsi, sizeof (struct rusage));
+			f->R.rax = thread_get_rusage((int)f->R.rdi, (struct rusage *)f->R.rsi);
+			break;
+		case SYS_UPTIME: // 부팅 후 경과 시간(ms)
+			f->R.rax = timer_ticks() * 1000 / TIMER_FREQ;
+			break;
+		case SYS_FUTEX_WAIT:
+			f->R.rax = futex_wait((int *)f->R.rdi, (int)f->R.rsi, (int)f->R.rdx);
+			break;
+		case SYS_FUTEX_WAKE:
+			f->R.rax = futex_wake((int *)f->R.rdi, (int)f->R.rsi);
+			break;
+		case SYS_THREAD_CREATE:
+			f->R.rax = process_thread_create((void *)f->R.rdi, f->R.rsi, f->R.rdx, f);
+			break;
+		case SYS_THREAD_JOIN:
+			f->R.rax = process_thread_join((tid_t)f->R.rdi);
+			break;
 		default:
 			printf("FATAL: UNDEFINED SYSTEM CALL!, %d", sys_call_number);
 			exit(-1);
 			break;
 	}
+	thread_charge_kernel(); // 유저 모드로 돌아가기 전까지는 커널에서 쓴 시간
 	// thread_exit ();
 }
@@ -4,6 +4,7 @@
 #include "userprog/gdt.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 
@@ -45,22 +46,24 @@
  *      stack pointer to point to the new thread's kernel stack.
  *      (The call is in schedule in thread.c.) */
 
-/* Kernel TSS. */
-struct task_state *tss;
+/* Every CPU has its own kernel TSS, since every CPU needs its
+   own ring 0 stack.  It is found through this_cpu ()->tss. */
 
-/* Initializes the kernel TSS. */
+/* Initializes the running CPU's kernel TSS. */
 void
 tss_init (void) {
 	/* Our TSS is never used in a call gate or task gate, so only a
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
-	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	this_cpu ()->tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 	tss_update (thread_current ());
 }
 
-/* Returns the kernel TSS. */
+/* Returns the running CPU's kernel TSS. */
 struct task_state *
 tss_get (void) {
+	struct task_state *tss = this_cpu ()->tss;
+
 	ASSERT (tss != NULL);
 	return tss;
 }
@@ -69,6 +72,5 @@ tss_get (void) {
  * of the thread stack. */
 void
 tss_update (struct thread *next) {
-	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	tss_get ()->rsp0 = (uint64_t) next + PGSIZE;
 }
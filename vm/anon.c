@@ -38,7 +38,7 @@ void vm_anon_init(void) {
 }
 
 /* Initialize the file mapping */
-bool anon_initializer(struct page *page, enum vm_type type, void *kva) {
+bool anon_initializer(struct page *page, enum vm_type type, void *kva UNUSED) {
     /* 핸들러 설정 */
     page->operations = &anon_ops;
 
@@ -46,10 +46,7 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva) {
     struct anon_page *anon_page = &page->anon;
     anon_page->swap_idx = -1;
 
-    /* kva가 유효하면 0으로 초기화 */
-    if (kva != NULL) {
-        memset(kva, 0, PGSIZE);
-    }
+    /* kva는 vm_do_claim_page()가 이미 0으로 채워서 줌 (idle 때 미리 채운 페이지일 수 있음) */
 
     return true;
 }
@@ -1,6 +1,7 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
@@ -38,13 +39,10 @@ static bool file_backed_swap_in (struct page *page, void *kva) {
 	size_t page_read_bytes = aux->read_bytes;
 	size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-    lock_acquire(&g_filesys_lock);  
     // file_read_at을 사용
     if (file_read_at(aux->file, kva, aux->read_bytes, aux->ofs) != (int) aux->read_bytes) {
-    	lock_release(&g_filesys_lock);  
         return false;
     }
-    lock_release(&g_filesys_lock);
 
 	memset(kva + page_read_bytes, 0, page_zero_bytes);
 	return true;
@@ -60,9 +58,7 @@ static bool file_backed_swap_out (struct page *page) {
 	if (pml4_is_dirty(curr->pml4, page->va)){
 		aux = (struct file_lazy_aux *) page->uninit.aux;
 
-    	lock_acquire(&g_filesys_lock);  
 		file_write_at(aux->file, page->frame->kva, aux->read_bytes, aux->ofs);
-    	lock_release(&g_filesys_lock);  
 
 		// Write back 후 dirty bit를 원상 복구한다
 		pml4_set_dirty (curr->pml4, page->va, 0);
@@ -82,9 +78,7 @@ static void file_backed_destroy(struct page *page) {
 
 	// 페이지가 dirty ==> 해당 파일에 write back.
 	if (pml4_is_dirty(curr->pml4, page->va) && page->writable) {
-		lock_acquire(&g_filesys_lock);
 		file_write_at(aux->file, page->frame->kva, aux->read_bytes, aux->ofs);
-		lock_release(&g_filesys_lock);
 
 		// Write back 후 dirty bit를 원상 복구.
 		pml4_set_dirty(curr->pml4, page->va, false);
@@ -104,14 +98,14 @@ static void file_backed_destroy(struct page *page) {
 
 		// 물리 프레임 및 페이지 free
 		palloc_free_page(f->kva);
-		free(f);
+		kmem_cache_free(frame_struct_cache, f);
 
 		page->frame = NULL;
 	}
 
 	// aux 존재할 경우 free
 	if (aux != NULL) {
-		free(aux);
+		kmem_cache_free(lazy_aux_cache, aux);
 		page->uninit.aux = NULL;
 	}
 }
@@ -128,9 +122,7 @@ void* do_mmap(void *addr, size_t length, int writable, struct file *file, off_t
 	size_t total_pages = (read_bytes + zero_bytes) / PGSIZE;
 
 	// 이래야 별도의 file descriptor가 되기 때문.
-	lock_acquire(&g_filesys_lock);
 	struct file *mapping_file = file_reopen(file);
-	lock_release(&g_filesys_lock);
 
 	// 각 페이지를 매칭
 	for (size_t i = 0; i < total_pages; i++) {
@@ -138,7 +130,7 @@ void* do_mmap(void *addr, size_t length, int writable, struct file *file, off_t
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		// lazy-load를 위한 aux 설정
-		struct file_lazy_aux *aux = malloc(sizeof(struct file_lazy_aux));
+		struct file_lazy_aux *aux = kmem_cache_alloc(lazy_aux_cache);
 		if (aux == NULL) 
 			return NULL;
 		
@@ -150,7 +142,7 @@ void* do_mmap(void *addr, size_t length, int writable, struct file *file, off_t
 		// lazy-load 페이지
 		if (!vm_alloc_page_with_initializer(
 					VM_FILE, addr, writable, lazy_load_segment, aux)) {
-			free(aux);
+			kmem_cache_free(lazy_aux_cache, aux);
 			return NULL;
 		}
 
@@ -174,7 +166,7 @@ void do_munmap (void *addr) {
 	// 파일이 끝날 때까지 반복
 	while (true){
 		// 파일 찾기
-		page = spt_find_page(&curr->spt, addr);
+		page = spt_find_page(&curr->leader->spt, addr);
         // 파일의 끝인지 확인 - 안되면 그냥 break!
 		if (!page || page_get_type(page) != VM_FILE)
             break;
@@ -183,9 +175,7 @@ void do_munmap (void *addr) {
 		if (pml4_is_dirty(curr->pml4, page->va)){
 			aux = (struct file_lazy_aux *) page->uninit.aux;
 
-			lock_acquire(&g_filesys_lock);
 			file_write_at(aux->file, addr, aux->read_bytes, aux->ofs);
-			lock_release(&g_filesys_lock);
 
             pml4_set_dirty (curr->pml4, page->va, 0);
 		}
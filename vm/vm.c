@@ -1,12 +1,18 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "kernel/hash.h"
 
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
+#include <string.h>
+
+struct kmem_cache *page_struct_cache;
+struct kmem_cache *frame_struct_cache;
+struct kmem_cache *lazy_aux_cache;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -23,6 +29,15 @@ vm_init (void) {
 
 	lock_init(&g_frame_lock);
 	list_init(&g_frame_table);
+
+	// 자주 할당되는 구조체는 크기에 딱 맞는 전용 캐시에서 할당 (malloc은 2의 거듭제곱으로 올림)
+	page_struct_cache = kmem_cache_create ("struct page", sizeof (struct page), 0, NULL);
+	frame_struct_cache = kmem_cache_create ("struct frame", sizeof (struct frame), 0, NULL);
+	lazy_aux_cache = kmem_cache_create ("struct file_lazy_aux",
+			sizeof (struct file_lazy_aux), 0, NULL);
+	if (page_struct_cache == NULL || frame_struct_cache == NULL
+			|| lazy_aux_cache == NULL)
+		PANIC ("vm_init: out of memory");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -43,6 +58,12 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static struct page *spt_lookup (struct supplemental_page_table *spt, void *va);
+static bool vm_alloc_page_locked (struct supplemental_page_table *spt,
+		enum vm_type type, void *upage, bool writable,
+		vm_initializer *init, void *aux);
+static bool copy_pages (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
 
 /* 유틸, 헬퍼 ~ */
 static inline bool is_target_stack(void* rsp, void* addr) {
@@ -59,7 +80,7 @@ static void vm_free_frame(struct frame *frame) {
 	
 	list_remove(&frame->f_elem); // 프레임 테이블로부터 제거
 	palloc_free_page(frame->kva); // 실제 프레임을 제거
-	free(frame); // 할당했던 메모리 free 
+	kmem_cache_free(frame_struct_cache, frame); // 할당했던 메모리 free 
 
 	lock_release(&g_frame_lock);
 }
@@ -86,21 +107,34 @@ bool page_less(const struct hash_elem *a_,
 bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, //새로운 uninit 페이지 생성 + uninit_new()로 
 		vm_initializer *init, void *aux) {
+	struct supplemental_page_table *spt = &thread_current ()->leader->spt; //초기화 SPT에 등록(중복 방지)
+	bool success;
+
+	lock_acquire (&spt->lock);
+	success = vm_alloc_page_locked (spt, type, upage, writable, init, aux);
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* vm_alloc_page_with_initializer()의 본체. SPT의 락을 잡은 채로 호출. */
+static bool
+vm_alloc_page_locked (struct supplemental_page_table *spt, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux) {
 	// 참고: 여기서 enum vm_type type란, 얘가 미래에 될 타입.
 	ASSERT (VM_TYPE(type) != VM_UNINIT); 
-
-	struct supplemental_page_table *spt = &thread_current ()->spt; //초기화 SPT에 등록(중복 방지)
+	ASSERT (lock_held_by_current_thread (&spt->lock));
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) { //SPT(해시 테이블)에서 VA로 페이지 찾기
+	if (spt_lookup (spt, upage) == NULL) { //SPT(해시 테이블)에서 VA로 페이지 찾기
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
 		 * TODO: should modify the field after calling the uninit_new. */
 		 
-		// 새 페이지를 콜록
-		struct page *page = (struct page *)calloc(1, sizeof(struct page));
+		// 새 페이지를 할당하고 0으로 초기화
+		struct page *page = kmem_cache_alloc(page_struct_cache);
 		if (page == NULL)
 			goto err;
+		memset(page, 0, sizeof *page);
 
 		// 필드들 초기화
 		bool (*page_initializer)(struct page *, enum vm_type, void *);
@@ -122,7 +156,7 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, /
 		// hash_insert 대신 spt_insert_page 사용하게끔 수정 :
 		bool is_inserted = spt_insert_page(spt, page);
 		if (!is_inserted) {
-			free (page);
+			kmem_cache_free (page_struct_cache, page);
 			goto err;
 		}
 
@@ -137,26 +171,37 @@ err:
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page (struct supplemental_page_table *spt, void *va){
+	struct page *page;
+
+	lock_acquire (&spt->lock);
+	page = spt_lookup (spt, va);
+	lock_release (&spt->lock);
+	return page;
+}
+
+/* spt_find_page()의 본체. SPT의 락을 잡은 채로 호출. */
+static struct page *
+spt_lookup (struct supplemental_page_table *spt, void *va){
     ASSERT (spt != NULL);
 	
-    /* VA의 field set 기반으로 더미 struct page를 만듦 */
-	struct page* page_p = (struct page *)malloc(sizeof(struct page));
+    /* VA의 field set 기반으로 더미 struct page를 만듦 (va만 쓰므로 스택에 둬도 충분) */
+	struct page key;
 	struct page* found_page = NULL;
-    page_p->va = pg_round_down (va); // 페이지 경계에 맞도록 조정
+    key.va = pg_round_down (va); // 페이지 경계에 맞도록 조정
 
     /* 해시 테이블을 조회 */
-    struct hash_elem *e = hash_find (&spt->main_table, &page_p->page_hashelem);
+    struct hash_elem *e = hash_find (&spt->main_table, &key.page_hashelem);
     if (e != NULL){
 		found_page = hash_entry (e, struct page, page_hashelem);
 	}
-	free(page_p);
     return found_page;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt ,struct page *page) { //페이지를 SPT에 삽입(중복방지)
+spt_insert_page (struct supplemental_page_table *spt ,struct page *page) { //페이지를 SPT에 삽입(중복방지). SPT의 락을 잡은 채로 호출
 	int succ = true;
+	ASSERT (lock_held_by_current_thread (&spt->lock));
 	// hash_insert 함수를 사용해서 spt에 넣을 물건 page를 던진다.
 	// hash_insert는 적절한 위치를 탐색하고, 중복 탐색도 합니다. (중복은 삽입 안됩니다!)
 	// insert_elem으로 삽입에 대한 핵심 로직이 이루어집니다.
@@ -220,21 +265,24 @@ static struct frame* vm_evict_frame (void) {
 
 /* palloc()을 호출하고 프레임을 얻습니다. 사용 가능한 페이지가 없으면 페이지를 
  * 축출(evict)하고 반환합니다. 이 함수는 항상 유효한 주소를 반환합니다. 즉, 사용자 풀
- * 메모리가 가득 차면, 이 함수는 프레임을 축출하여 사용 가능한 메모리 공간을 확보합니다.*/
-static struct frame* vm_get_frame (void) {
-	struct frame* new_frame = (struct frame *)malloc(sizeof(struct frame));
+ * 메모리가 가득 차면, 이 함수는 프레임을 축출하여 사용 가능한 메모리 공간을 확보합니다.
+ * ZERO이면 0으로 채워진 프레임을 반환합니다. 가능하면 idle 때 미리 0으로 채워 둔 페이지를 씀.*/
+static struct frame* vm_get_frame (bool zero) {
+	struct frame* new_frame = kmem_cache_alloc(frame_struct_cache);
 	if(new_frame == NULL) {
 		// palloc_free_page(new_frame->kva);
 		// lock_release(&g_frame_lock);
-		PANIC("struct frame에 대한 malloc 실패!");
+		PANIC("struct frame 할당 실패!");
 	}
 
-	void* new_page = palloc_get_page(PAL_USER);
+	void* new_page = palloc_get_page(zero ? PAL_USER | PAL_ZERO : PAL_USER);
 	/* 할당 실패 시 eviction policy 집행 */
 	new_frame->kva = new_page;
 	if (!new_frame->kva){
 		new_frame = vm_evict_frame();
 		new_frame->page = NULL;
+		if (zero)
+			memset(new_frame->kva, 0, PGSIZE);
         return new_frame;
 	}
 
@@ -257,10 +305,12 @@ vm_stack_growth (void *addr UNUSED) {
 	// 이 함수의 행위 책임 :
 		// 스택 성장 처리 (ok)
 		// 스택 성장 필요 유무를 확인 (?)
+		// vm_try_handle_fault()에서 SPT의 락을 잡은 채로 호출됨
 		void *new_page_addr = pg_round_down(addr);
 
 		 /* 스택은 익명 페이지로 할당 (VM_ANON) */
-		 bool success = vm_alloc_page_with_initializer(
+		 bool success = vm_alloc_page_locked(
+			&thread_current()->leader->spt,
 			VM_ANON,        // 타입: 익명 페이지
 			new_page_addr,  // 페이지의 가상주소
 			true,           // 쓰기 가능
@@ -285,8 +335,9 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED,
 						bool write UNUSED, 
 						bool not_present UNUSED) 
 {
-	struct supplemental_page_table *spt UNUSED = &thread_current()->spt;
+	struct supplemental_page_table *spt UNUSED = &thread_current()->leader->spt;
 	struct page *page = NULL;
+	bool success = false;
 
 	// 얼리 리턴
 	// 아! 커널 쓰레드는 page fault 날 일 자체가 없다!
@@ -299,7 +350,10 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED,
 	if (!user)			// kernel access인 경우 thread에서 rsp를 가져와야 한다.
 		rsp = thread_current()->rsp;
 
-	page = spt_find_page(spt, addr);
+	// 같은 프로세스의 다른 스레드도 SPT를 고치거나 같은 페이지에서 폴트를 낼 수 있으므로
+	// 조회부터 클레임까지 SPT의 락을 잡고 진행
+	lock_acquire(&spt->lock);
+	page = spt_lookup(spt, addr);
 	// 페이지가 SPT에 없음
 	if (page == NULL) {
 		// 스택 확장으로 처리할 수 있는 폴트인 경우
@@ -307,20 +361,24 @@ bool vm_try_handle_fault(struct intr_frame *f UNUSED,
 			// vm_stack_growth()로 스택을 확장
 			vm_stack_growth(addr);
 			// 새 페이지를 얻어 claim
-			page = spt_find_page(spt, addr);
+			page = spt_lookup(spt, addr);
 			if (page == NULL)
-        		return false;
+        		goto done;
 		}else{
 			// 스택 확장으로 안되는 건 어쩔 수 없다.
-			return false;
+			goto done;
 		}
 	}
 
 	// write 불가능한 페이지에 write를 요청함
     if (write && (page == NULL || !page->writable))  
-		return false;
+		goto done;
 
-	return vm_do_claim_page(page);
+	// 락을 기다리는 동안 다른 스레드가 이미 클레임했다면 할 일이 없음
+	success = page->frame != NULL || vm_do_claim_page(page);
+done:
+	lock_release(&spt->lock);
+	return success;
 }
 
 
@@ -338,19 +396,29 @@ vm_claim_page (void *va UNUSED) {
 	struct page *page = NULL;
 	/* TODO: Fill this function */
 	// vm에 
-	struct supplemental_page_table *spt = &thread_current()->spt;
-	page = spt_find_page(spt, va);
-	if (page == NULL)
-		return false;  // SPT에 없는 경우
+	struct supplemental_page_table *spt = &thread_current()->leader->spt;
+	bool success;
 
-	return vm_do_claim_page(page); // 프레임 할당, 내용 초기화, PTE 설정 등
+	lock_acquire(&spt->lock);
+	page = spt_lookup(spt, va);
+	if (page == NULL)
+		success = false;  // SPT에 없는 경우
+	else if (page->frame != NULL)
+		success = true;   // 같은 프로세스의 다른 스레드가 이미 클레임
+	else
+		success = vm_do_claim_page(page); // 프레임 할당, 내용 초기화, PTE 설정 등
+	lock_release(&spt->lock);
+	return success;
 }
 
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
 	ASSERT (page != NULL);
-	struct frame *frame = vm_get_frame ();
+	/* 처음 클레임되는 익명 페이지는 0으로 채워진 프레임이 필요함 (anon_initializer 참고) */
+	bool zero = VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON;
+	struct frame *frame = vm_get_frame (zero);
 	if (frame == NULL)
 		return false;
 
@@ -389,7 +457,7 @@ vm_do_claim_page (struct page *page) {
 void
 supplemental_page_table_init (struct supplemental_page_table *spt ) { //SPT 해시 테이블 초기화
 	hash_init(&spt->main_table, page_hash, page_less, NULL);
-	// lock_init(&spt->spt_lock);
+	lock_init(&spt->lock);
 }
 
 /* Copy supplemental page table from src to dst */
@@ -398,6 +466,17 @@ supplemental_page_table_copy (struct supplemental_page_table *dst,
 		struct supplemental_page_table *src ) {
 	// src에서 dst로 supplemental_page_table 복사하기.
 	
+	// 부모 프로세스의 다른 스레드들이 src를 고치지 못하도록 복사하는 동안 락을 잡음
+	lock_acquire(&src->lock);
+	bool success = copy_pages (dst, src);
+	lock_release(&src->lock);
+	return success;
+}
+
+/* supplemental_page_table_copy()의 본체. SRC의 락을 잡은 채로 호출. */
+static bool
+copy_pages (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src ) {
 	if(hash_empty(&src->main_table)) return true; // 복사할게 없네용 : true 반환
 	struct hash_iterator i;
 	hash_first (&i, &src->main_table);